@@ -97,6 +97,28 @@ typedef enum VkhMemoryUsage
     VKH_MEMORY_USAGE_MAX_ENUM = 0x7FFFFFFF
 } VkhMemoryUsage;
 
+typedef enum VkhDownsampleFilter {
+    VKH_DOWNSAMPLE_FILTER_BOX = 0,     /** 2x2 average */
+    VKH_DOWNSAMPLE_FILTER_KAISER = 1,  /** 6x6 kaiser windowed sinc on levels computed from mip 0 and mip 6, box on others */
+} VkhDownsampleFilter;
+
+typedef enum VkhQueueUsage {
+    VKH_QUEUE_USAGE_GRAPHICS = 0,
+    VKH_QUEUE_USAGE_PRESENT = 1,
+    VKH_QUEUE_USAGE_ASYNC_COMPUTE = 2,   /** compute only family preferred */
+    VKH_QUEUE_USAGE_TRANSFER = 3,        /** transfer only family preferred */
+} VkhQueueUsage;
+
+typedef enum VkhQueueBalance {
+    VKH_QUEUE_BALANCE_ROUND_ROBIN = 0,
+    VKH_QUEUE_BALANCE_LEAST_LEASED = 1,  /** queue with the fewest acquisitions not yet released */
+} VkhQueueBalance;
+
+typedef enum VkhGraphQueue {
+    VKH_GRAPH_QUEUE_GRAPHICS = 0,
+    VKH_GRAPH_QUEUE_ASYNC_COMPUTE = 1,   /** run on the graphics queue if no compute queue is given to execute */
+} VkhGraphQueue;
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
@@ -141,6 +163,97 @@ typedef struct _vkh_image_t*    VkhImage;
 typedef struct _vkh_buffer_t*   VkhBuffer;
 typedef struct _vkh_queue_t*    VkhQueue;
 typedef struct _vkh_presenter_t* VkhPresenter;
+typedef struct _vkh_alias_pool_t* VkhAliasPool;
+typedef struct _vkh_downsampler_t* VkhDownsampler;
+typedef struct _vkh_cmd_allocator_t* VkhCmdAllocator;
+typedef struct _vkh_job_system_t* VkhJobSystem;
+typedef struct _vkh_submit_t* VkhSubmit;
+typedef struct _vkh_queue_manager_t* VkhQueueManager;
+typedef struct _vkh_render_graph_t* VkhRenderGraph;
+typedef struct _vkh_profiler_t* VkhProfiler;
+typedef struct _vkh_completion_t* VkhCompletion;
+typedef struct _vkh_timeline_t* VkhTimeline;
+
+#define VKH_PROFILER_NAME_SIZE  32
+
+//GPU time of a labeled command buffer region, in milliseconds.
+typedef struct VkhGpuRegion {
+    char        name[VKH_PROFILER_NAME_SIZE];
+    uint32_t    depth;
+    uint32_t    parent;     /** index of the enclosing region, UINT32_MAX if none */
+    double      start;
+    double      duration;
+    uint64_t    hostTime;   /** start in vkh_host_time nanoseconds, 0 if the device is not calibrated */
+} VkhGpuRegion;
+
+//vkQueueSubmit of labeled command buffers, GPU times span its profiled regions.
+typedef struct VkhGpuSubmit {
+    uint64_t    submitTime;     /** vkh_host_time of the vkQueueSubmit */
+    uint64_t    gpuStart;       /** first region start in vkh_host_time, 0 if the device is not calibrated */
+    uint64_t    gpuEnd;         /** last region end in vkh_host_time, 0 if the device is not calibrated */
+    double      latency;        /** milliseconds from submit to gpuStart, 0 if the device is not calibrated */
+    double      idleBefore;     /** milliseconds the queue spent idle since the previous profiled submission of the frame */
+    uint32_t    regionCount;
+} VkhGpuSubmit;
+
+//GPU work completion queued by a VkhCompletion watch without callback.
+typedef struct VkhCompletionEvent {
+    void*       userData;
+    VkSemaphore timeline;   /** watched timeline, VK_NULL_HANDLE for fences */
+    uint64_t    value;
+    VkFence     fence;
+    VkResult    result;     /** VK_SUCCESS, or the device loss error */
+} VkhCompletionEvent;
+
+//presentation timing of a VkhPresenter frame, times are vkh_host_time nanoseconds.
+typedef struct VkhFrameTiming {
+    uint64_t    presentId;      /** present id, frame number if VK_KHR_present_id is not enabled */
+    uint64_t    acquireTime;    /** before swapchain image acquisition */
+    uint64_t    presentTime;    /** vkQueuePresentKHR call */
+    uint64_t    displayTime;    /** present completion observed with VK_KHR_present_wait, 0 if unknown */
+} VkhFrameTiming;
+
+//pacing over the last frames, in milliseconds.
+typedef struct VkhPacingStats {
+    uint32_t    frames;
+    double      frameTime;      /** average interval between presents */
+    double      frameTimeJitter;/** standard deviation of that interval */
+    double      latency;        /** average acquire to display, or to present call without present wait */
+    double      maxLatency;
+} VkhPacingStats;
+
+#define VKH_STATS_MEMORY_USAGES 7
+
+//process wide counters covering all devices, see vkh_get_stats.
+typedef struct VkhStats {
+    int64_t     buffers;            /** alive VkhBuffer */
+    int64_t     images;             /** alive VkhImage */
+    int64_t     memory[VKH_STATS_MEMORY_USAGES];   /** bytes owned by alive buffers and images per VkhMemoryUsage */
+    uint64_t    allocations;        /** buffer and image memory allocations */
+    uint64_t    allocationTime;     /** nanoseconds spent in them */
+    uint64_t    commandBuffers;     /** allocated command buffers */
+    uint64_t    submits;            /** vkQueueSubmit calls */
+    uint64_t    submitInfos;        /** VkSubmitInfo in those calls */
+    uint64_t    barriers;           /** pipeline barriers recorded by vkh */
+    uint64_t    fences;             /** created fences */
+    uint64_t    semaphores;         /** created semaphores */
+    uint64_t    presents;
+} VkhStats;
+
+/**
+ * @brief called when the last reference of a VkhImage (VK_OBJECT_TYPE_IMAGE) or a VkhBuffer (VK_OBJECT_TYPE_BUFFER)
+ * is released, returning true keeps the object alive for recycling. Objects owned by vkh (render graph transients,
+ * swapchain images, staging buffers) are never passed to the hook. Recycled objects are finally destroyed with
+ * vkh_image_destroy_force or vkh_buffer_destroy_force which skip the hook.
+ */
+typedef bool (*VkhReleaseHook) (void* userData, VkObjectType objectType, void* object);
+
+typedef void (*VkhJobFunc)		(void* userData);
+typedef void (*VkhJobRangeFunc)	(void* userData, uint32_t begin, uint32_t end, uint32_t workerIndex);
+typedef void (*VkhCmdRecordFunc)(void* userData, VkCommandBuffer cmd, uint32_t begin, uint32_t end);
+typedef void (*VkhPassFunc)		(void* userData, VkCommandBuffer cmd);
+typedef void (*VkhCompletionFunc)(void* userData, VkResult result);
+typedef void (*VkhFrameFunc)	(void* userData, uint64_t frameId, VkhImage image, const void* pixels);
 
 /*************
  * VkhApp    *
@@ -193,6 +306,8 @@ vkh_public
 bool vkh_phyinfo_create_transfer_queues		(VkhPhyInfo phy, uint32_t queueCount, const float* queue_priorities, VkDeviceQueueCreateInfo* const qInfo);
 vkh_public
 bool vkh_phyinfo_create_compute_queues		(VkhPhyInfo phy, uint32_t queueCount, const float* queue_priorities, VkDeviceQueueCreateInfo* const qInfo);
+vkh_public
+const VkDeviceQueueCreateInfo* vkh_phyinfo_create_all_queues (VkhPhyInfo phy, uint32_t* pQueueInfoCount);
 
 vkh_public
 bool vkh_phyinfo_try_get_extension_properties (VkhPhyInfo phy, const char* name, const VkExtensionProperties* properties);
@@ -218,6 +333,14 @@ VkPhysicalDevice    vkh_device_get_phy          (VkhDevice dev);
  */
 vkh_public
 VkhApp	vkh_device_get_app	(VkhDevice dev);
+vkh_public
+bool	vkh_device_host_image_copy_supported (VkhDevice dev);
+vkh_public
+void	vkh_device_enable_synchronization2 (VkhDevice dev);
+vkh_public
+void	vkh_device_enable_present_wait (VkhDevice dev);
+vkh_public
+void	vkh_device_set_release_hook (VkhDevice dev, VkhReleaseHook hook, void* userData);
 
 vkh_public
 void vkh_device_set_object_name (VkhDevice dev, VkObjectType objectType, uint64_t handle, const char *name);
@@ -228,13 +351,42 @@ VkSampler vkh_device_create_sampler (VkhDevice dev, VkFilter magFilter, VkFilter
 vkh_public
 void vkh_device_destroy_sampler (VkhDevice dev, VkSampler sampler);
 
+/**
+ * @brief map timestamp queries on the host clock returned by vkh_host_time.
+ */
+vkh_public
+uint64_t    vkh_host_time                           ();
+vkh_public
+bool        vkh_device_calibrate_timestamps         (VkhDevice dev, VkhQueue queue);
+vkh_public
+bool        vkh_device_is_calibrated                (VkhDevice dev);
+vkh_public
+uint64_t    vkh_device_get_calibration_deviation    (VkhDevice dev);
+vkh_public
+uint64_t    vkh_device_gpu_to_host_time             (VkhDevice dev, uint64_t ticks);
+
+//stats are not tied to a device, they cover the whole process.
+vkh_public
+void        vkh_get_stats                           (VkhStats* stats);
+vkh_public
+void        vkh_reset_stats                         (void);
+
 /****************
  * VkhPresenter *
  ****************/
+/**
+ * @brief Without surface, the presenter is headless and cycles a ring of offscreen images left in transfer source
+ * layout, finished frames are handed to the frame callback.
+ */
 vkh_public
 VkhPresenter vkh_presenter_create (VkhDevice dev, uint32_t presentQueueFamIdx, VkSurfaceKHR surface,
                                                                    uint32_t width, uint32_t height,
                                                                    VkFormat preferedFormat, VkPresentModeKHR presentMode);
+//share 'presentQueue' with the other submitters of the application instead of creating one.
+vkh_public
+VkhPresenter vkh_presenter_create_with_queue (VkhDevice dev, VkhQueue presentQueue, VkSurfaceKHR surface,
+                                                                   uint32_t width, uint32_t height,
+                                                                   VkFormat preferedFormat, VkPresentModeKHR presentMode);
 vkh_public
 void        vkh_presenter_destroy (VkhPresenter r);
 vkh_public
@@ -247,6 +399,59 @@ vkh_public
 void        vkh_presenter_create_swapchain  (VkhPresenter r);
 vkh_public
 void		vkh_presenter_get_size			(VkhPresenter r, uint32_t* pWidth, uint32_t* pHeight);
+vkh_public
+void        vkh_presenter_resize                (VkhPresenter r, uint32_t width, uint32_t height);
+vkh_public
+void        vkh_presenter_set_frames_in_flight  (VkhPresenter r, uint32_t frameCount);
+vkh_public
+uint32_t    vkh_presenter_get_frames_in_flight  (VkhPresenter r);
+vkh_public
+uint32_t    vkh_presenter_get_frame_index       (VkhPresenter r);
+/**
+ * @brief Frame pacing, at most maxQueued presents may be pending. Waits use VK_KHR_present_wait once declared with
+ * vkh_device_enable_present_wait, else the draw fences which only bound the gpu queue.
+ */
+vkh_public
+void        vkh_presenter_set_max_queued_frames (VkhPresenter r, uint32_t maxQueued);
+vkh_public
+bool        vkh_presenter_present_wait_supported(VkhPresenter r);
+vkh_public
+uint32_t    vkh_presenter_get_frame_timings     (VkhPresenter r, VkhFrameTiming* timings, uint32_t maxCount);
+vkh_public
+void        vkh_presenter_get_pacing_stats      (VkhPresenter r, VkhPacingStats* stats);
+vkh_public
+void        vkh_presenter_set_frame_callback    (VkhPresenter r, VkhFrameFunc func, void* userData, uint32_t readbackTexelSize);
+vkh_public
+void        vkh_presenter_flush_frames          (VkhPresenter r);
+vkh_public
+VkImageLayout   vkh_presenter_get_present_layout(VkhPresenter r);
+vkh_public
+void            vkh_presenter_cmd_init_image    (VkhPresenter r, VkCommandBuffer cmd, uint32_t index);
+vkh_public
+uint32_t        vkh_presenter_get_image_count   (VkhPresenter r);
+vkh_public
+VkhImage        vkh_presenter_get_image         (VkhPresenter r, uint32_t index);
+vkh_public
+VkCommandBuffer vkh_presenter_get_cmd_buffer    (VkhPresenter r, uint32_t index);
+/**
+ * @brief Direct rendering to the swapchain images, with the presenter render pass and framebuffers or with
+ * dynamic rendering, instead of blitting an offscreen image.
+ */
+vkh_public
+void            vkh_presenter_create_render_pass    (VkhPresenter r, VkAttachmentLoadOp loadOp);
+vkh_public
+VkRenderPass    vkh_presenter_get_render_pass       (VkhPresenter r);
+vkh_public
+VkFramebuffer   vkh_presenter_get_framebuffer       (VkhPresenter r, uint32_t index);
+vkh_public
+void            vkh_presenter_cmd_begin_render_pass (VkhPresenter r, VkCommandBuffer cmd, uint32_t index, const VkClearValue* clearValue);
+#ifdef VK_VERSION_1_3
+vkh_public
+void            vkh_presenter_cmd_begin_rendering   (VkhPresenter r, VkCommandBuffer cmd, uint32_t index, VkAttachmentLoadOp loadOp,
+                                                     const VkClearValue* clearValue);
+vkh_public
+void            vkh_presenter_cmd_end_rendering     (VkhPresenter r, VkCommandBuffer cmd, uint32_t index);
+#endif
 /************
  * VkhImage *
  ************/
@@ -256,11 +461,34 @@ vkh_public
 VkhImage vkh_image_create       (VkhDevice pDev, VkFormat format, uint32_t width, uint32_t height, VkImageTiling tiling,
                                                                         VkhMemoryUsage memprops, VkImageUsageFlags usage);
 vkh_public
+VkhImage vkh_image_create_unbound (VkhDevice pDev, VkFormat format, uint32_t width, uint32_t height, VkImageTiling tiling,
+                                                                        VkImageUsageFlags usage);
+vkh_public
 VkhImage vkh_image_ms_create    (VkhDevice pDev, VkFormat format, VkSampleCountFlagBits num_samples, uint32_t width, uint32_t height,
                                                                         VkhMemoryUsage memprops, VkImageUsageFlags usage);
 vkh_public
 VkhImage vkh_tex2d_array_create (VkhDevice pDev, VkFormat format, uint32_t width, uint32_t height, uint32_t layers,
                                                                         VkhMemoryUsage memprops, VkImageUsageFlags usage);
+/**
+ * @brief 2d image with 'mipLevels' levels, 0 for the full mip chain. To generate its mips with a VkhDownsampler,
+ * 'usage' must include VK_IMAGE_USAGE_STORAGE_BIT and VK_IMAGE_USAGE_SAMPLED_BIT.
+ */
+vkh_public
+VkhImage vkh_tex2d_create_mipmapped (VkhDevice pDev, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels,
+                                                                        VkhMemoryUsage memprops, VkImageUsageFlags usage);
+//2d array of 'layers' layers with 'mipLevels' levels, same requirements as vkh_tex2d_create_mipmapped.
+vkh_public
+VkhImage vkh_tex2d_array_create_mipmapped (VkhDevice pDev, VkFormat format, uint32_t width, uint32_t height, uint32_t layers,
+                                                                        uint32_t mipLevels, VkhMemoryUsage memprops, VkImageUsageFlags usage);
+vkh_public
+VkhImage vkh_tex3d_create       (VkhDevice pDev, VkFormat format, uint32_t width, uint32_t height, uint32_t depth,
+                                                                        VkhMemoryUsage memprops, VkImageUsageFlags usage);
+vkh_public
+VkhImage vkh_texcube_create     (VkhDevice pDev, VkFormat format, uint32_t size,
+                                                                        VkhMemoryUsage memprops, VkImageUsageFlags usage);
+vkh_public
+VkhImage vkh_texcube_array_create (VkhDevice pDev, VkFormat format, uint32_t size, uint32_t cubeCount,
+                                                                        VkhMemoryUsage memprops, VkImageUsageFlags usage);
 vkh_public
 void vkh_image_set_sampler      (VkhImage img, VkSampler sampler);
 vkh_public
@@ -275,6 +503,9 @@ vkh_public
 void vkh_image_set_layout       (VkCommandBuffer cmdBuff, VkhImage image, VkImageAspectFlags aspectMask, VkImageLayout old_image_layout,
                                                                         VkImageLayout new_image_layout, VkPipelineStageFlags src_stages, VkPipelineStageFlags dest_stages);
 vkh_public
+void vkh_image_set_layout_all   (VkCommandBuffer cmdBuff, VkhImage image, VkImageAspectFlags aspectMask, VkImageLayout old_image_layout,
+                                                                        VkImageLayout new_image_layout, VkPipelineStageFlags src_stages, VkPipelineStageFlags dest_stages);
+vkh_public
 void vkh_image_set_layout_subres(VkCommandBuffer cmdBuff, VkhImage image, VkImageSubresourceRange subresourceRange, VkImageLayout old_image_layout,
                                                                         VkImageLayout new_image_layout, VkPipelineStageFlags src_stages, VkPipelineStageFlags dest_stages);
 vkh_public
@@ -282,6 +513,8 @@ void vkh_image_destroy_sampler  (VkhImage img);
 vkh_public
 void vkh_image_destroy          (VkhImage img);
 vkh_public
+void vkh_image_destroy_force    (VkhImage img);
+vkh_public
 void vkh_image_reference		(VkhImage img);
 vkh_public
 void* vkh_image_map             (VkhImage img);
@@ -291,12 +524,60 @@ vkh_public
 void vkh_image_set_name         (VkhImage img, const char* name);
 vkh_public
 uint64_t vkh_image_get_stride	(VkhImage img);
+/**
+ * @brief Upload tightly packed texels to the first mip level of all the layers of the image and leave it in 'finalLayout'.
+ * If VK_EXT_host_image_copy is enabled, image was created with VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT and 'finalLayout' is
+ * a supported host copy destination layout, the copy and the layout transition are done on the host, else a staging
+ * buffer is submitted on 'queue' and waited for. 'size' must cover width * height * depth * layers texels of an
+ * uncompressed format, nothing is copied otherwise.
+ */
+vkh_public
+void vkh_image_copy_from_memory	(VkhImage img, VkhQueue queue, const void* data, VkDeviceSize size, VkImageLayout finalLayout);
+/**
+ * @brief Read back the first mip level of all the layers of the image, image is left in its current layout which
+ * must not be VK_IMAGE_LAYOUT_UNDEFINED. The host copy is used if the current layout is a supported source layout.
+ * 'size' requirements are the ones of vkh_image_copy_from_memory.
+ */
+vkh_public
+void vkh_image_copy_to_memory	(VkhImage img, VkhQueue queue, void* data, VkDeviceSize size);
+/**
+ * @brief Transition the image layout from the host with VK_EXT_host_image_copy.
+ * @return false if host transitions are not available for this image or these layouts.
+ */
+vkh_public
+bool vkh_image_host_set_layout	(VkhImage img, VkImageAspectFlags aspectMask, VkImageLayout new_image_layout);
+/**
+ * @brief Queue family ownership transfer of an exclusive image: release on the owning family then acquire on
+ * 'dstFamily', both submissions linked with a semaphore, see vkh_cmd_submit_ownership_transfer.
+ */
+vkh_public
+void vkh_image_cmd_release		(VkhImage img, VkCommandBuffer cmd, VkImageAspectFlags aspectMask, uint32_t dstFamily,
+                                 VkImageLayout newLayout, VkPipelineStageFlags srcStages);
+vkh_public
+void vkh_image_cmd_acquire		(VkhImage img, VkCommandBuffer cmd, VkImageAspectFlags aspectMask,
+                                 VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+vkh_public
+void vkh_image_set_owner_family	(VkhImage img, uint32_t qFamIndex);
+vkh_public
+uint32_t vkh_image_get_owner_family (VkhImage img);
+/**
+ * @brief Split layout transition: signal an event after the last use of the image, wait for it just before the
+ * next one so that the transition overlaps with the work recorded in between.
+ */
+vkh_public
+void vkh_image_cmd_signal_layout	(VkhImage img, VkCommandBuffer cmd, VkEvent evt, VkImageAspectFlags aspectMask,
+                                 VkImageLayout newLayout, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+                                 VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+vkh_public
+void vkh_image_cmd_wait_layout	(VkhImage img, VkCommandBuffer cmd, VkEvent evt);
 
 vkh_public
 VkImage                 vkh_image_get_vkimage   (VkhImage img);
 vkh_public
 VkImageView             vkh_image_get_view      (VkhImage img);
 vkh_public
+VkImageViewType         vkh_image_get_view_type (VkhImage img);
+vkh_public
 VkImageLayout           vkh_image_get_layout    (VkhImage img);
 vkh_public
 VkSampler               vkh_image_get_sampler   (VkhImage img);
@@ -313,8 +594,14 @@ vkh_public
 VkhBuffer   vkh_buffer_create   (VkhDevice pDev, VkBufferUsageFlags usage,
                                                                         VkhMemoryUsage memprops, VkDeviceSize size);
 vkh_public
+VkhBuffer   vkh_buffer_create_unbound (VkhDevice pDev, VkBufferUsageFlags usage, VkDeviceSize size);
+vkh_public
 void        vkh_buffer_destroy  (VkhBuffer buff);
 vkh_public
+void        vkh_buffer_destroy_force (VkhBuffer buff);
+vkh_public
+void        vkh_buffer_reference(VkhBuffer buff);
+vkh_public
 void		vkh_buffer_resize	(VkhBuffer buff, VkDeviceSize newSize, bool mapped);
 vkh_public
 void		vkh_buffer_reset	(VkhBuffer buff);
@@ -324,16 +611,91 @@ vkh_public
 void        vkh_buffer_unmap    (VkhBuffer buff);
 vkh_public
 void		vkh_buffer_flush	(VkhBuffer buff);
+vkh_public
+void		vkh_buffer_invalidate	(VkhBuffer buff);
+vkh_public
+void		vkh_buffer_cmd_release	(VkhBuffer buff, VkCommandBuffer cmd, uint32_t dstFamily, VkPipelineStageFlags srcStages);
+vkh_public
+void		vkh_buffer_cmd_acquire	(VkhBuffer buff, VkCommandBuffer cmd, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+vkh_public
+void		vkh_buffer_set_owner_family (VkhBuffer buff, uint32_t qFamIndex);
+vkh_public
+uint32_t	vkh_buffer_get_owner_family (VkhBuffer buff);
+vkh_public
+void		vkh_buffer_cmd_signal	(VkhBuffer buff, VkCommandBuffer cmd, VkEvent evt, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+                                 VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+vkh_public
+void		vkh_buffer_cmd_wait		(VkhBuffer buff, VkCommandBuffer cmd, VkEvent evt);
 
 vkh_public
 VkBuffer    vkh_buffer_get_vkbuffer			(VkhBuffer buff);
 vkh_public
 void*       vkh_buffer_get_mapped_pointer	(VkhBuffer buff);
 
+/****************
+ * VkhAliasPool *
+ ****************/
+/**
+ * @brief Transient resources created with vkh_image_create_unbound or vkh_buffer_create_unbound may share
+ * a single memory allocation if their lifetimes, expressed in pass indices, do not overlap.
+ */
+vkh_public
+VkhAliasPool    vkh_alias_pool_create       (VkhDevice dev, VkhMemoryUsage memprops);
+vkh_public
+void            vkh_alias_pool_destroy      (VkhAliasPool pool);
+vkh_public
+void            vkh_alias_pool_add_image    (VkhAliasPool pool, VkhImage img, uint32_t firstPass, uint32_t lastPass);
+vkh_public
+void            vkh_alias_pool_add_buffer   (VkhAliasPool pool, VkhBuffer buff, uint32_t firstPass, uint32_t lastPass);
+vkh_public
+VkResult        vkh_alias_pool_bind         (VkhAliasPool pool);
+vkh_public
+VkDeviceSize    vkh_alias_pool_get_size     (VkhAliasPool pool);
+vkh_public
+VkDeviceSize    vkh_alias_pool_get_unaliased_size (VkhAliasPool pool);
+vkh_public
+void            vkh_alias_pool_cmd_barriers (VkhAliasPool pool, VkCommandBuffer cmd, uint32_t pass);
+
+/******************
+ * VkhDownsampler *
+ ******************/
+/**
+ * @brief Single dispatch compute mip generator, available if vkh has been built with glslc. Images are created
+ * with vkh_tex2d_create_mipmapped or vkh_tex2d_array_create_mipmapped.
+ * The shaderStorageImageWriteWithoutFormat feature has to be enabled on the device, NULL is returned
+ * if the physical device does not support it.
+ * @param maxImages maximum number of mip generations recorded between two resets.
+ */
+vkh_public
+VkhDownsampler  vkh_downsampler_create      (VkhDevice dev, uint32_t maxImages);
+vkh_public
+void            vkh_downsampler_destroy     (VkhDownsampler ds);
+vkh_public
+bool            vkh_downsampler_cmd_generate(VkhDownsampler ds, VkCommandBuffer cmd, VkhImage img,
+                                             VkhDownsampleFilter filter, VkImageLayout finalLayout);
+/**
+ * @brief Release resources of the recorded generations, command buffers using them must have completed.
+ */
+vkh_public
+void            vkh_downsampler_reset       (VkhDownsampler ds);
+
 vkh_public
 VkFence         vkh_fence_create			(VkhDevice dev);
 vkh_public
 VkFence         vkh_fence_create_signaled	(VkhDevice dev);
+/**
+ * @brief Device fence pool, released fences are reset together on the next acquire.
+ */
+vkh_public
+VkFence         vkh_fence_acquire           (VkhDevice dev);
+vkh_public
+void            vkh_fence_release           (VkhDevice dev, VkFence fence);
+vkh_public
+bool            vkh_fence_is_ready          (VkhDevice dev, VkFence fence);
+vkh_public
+VkResult        vkh_fences_wait_all         (VkhDevice dev, uint32_t count, const VkFence* fences, uint64_t timeout);
+vkh_public
+VkResult        vkh_fences_wait_any         (VkhDevice dev, uint32_t count, const VkFence* fences, uint64_t timeout, uint32_t* pIndex);
 vkh_public
 VkSemaphore     vkh_semaphore_create		(VkhDevice dev);
 vkh_public
@@ -364,6 +726,93 @@ void vkh_cmd_submit (VkhQueue queue, VkCommandBuffer *pCmdBuff, VkFence fence);
 vkh_public
 void vkh_cmd_submit_with_semaphores(VkhQueue queue, VkCommandBuffer *pCmdBuff, VkSemaphore waitSemaphore,
                                                                         VkSemaphore signalSemaphore, VkFence fence);
+vkh_public
+void vkh_cmd_submit_ownership_transfer (VkhQueue srcQueue, VkCommandBuffer *pReleaseCmd, VkhQueue dstQueue,
+                                        VkCommandBuffer *pAcquireCmd, VkSemaphore link, VkPipelineStageFlags dstStages, VkFence fence);
+/**
+ * @brief One-shot submissions with command buffers and fences recycled per queue family.
+ */
+vkh_public
+VkCommandBuffer vkh_immediate_begin     (VkhQueue queue);
+vkh_public
+void            vkh_immediate_end       (VkhQueue queue, VkCommandBuffer cmd);
+vkh_public
+uint64_t        vkh_immediate_end_async (VkhQueue queue, VkCommandBuffer cmd);
+vkh_public
+void            vkh_immediate_wait      (VkhQueue queue, uint64_t value);
+
+/*************
+ * VkhSubmit *
+ *************/
+/**
+ * @brief Submission builder with any number of command buffers, binary or timeline waits with their own
+ * stage mask, signals and an optional fence.
+ */
+vkh_public
+VkhSubmit   vkh_submit_create       ();
+vkh_public
+void        vkh_submit_destroy      (VkhSubmit sub);
+vkh_public
+void        vkh_submit_reset        (VkhSubmit sub);
+vkh_public
+void        vkh_submit_add_cmd      (VkhSubmit sub, VkCommandBuffer cmd);
+vkh_public
+void        vkh_submit_add_wait     (VkhSubmit sub, VkSemaphore semaphore, VkPipelineStageFlags stages);
+vkh_public
+void        vkh_submit_add_timeline_wait    (VkhSubmit sub, VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stages);
+vkh_public
+void        vkh_submit_add_signal   (VkhSubmit sub, VkSemaphore semaphore);
+vkh_public
+void        vkh_submit_add_timeline_signal  (VkhSubmit sub, VkSemaphore semaphore, uint64_t value);
+vkh_public
+void        vkh_submit_set_fence    (VkhSubmit sub, VkFence fence);
+vkh_public
+VkResult    vkh_submit_commit       (VkhSubmit sub, VkhQueue queue);
+vkh_public
+void        vkh_submit_enqueue      (VkhSubmit sub, VkhQueue queue);
+
+/*******************
+ * VkhCmdAllocator *
+ *******************/
+/**
+ * @brief Command buffers recycled per recording thread and per frame slot, each thread has its own pool for each slot.
+ */
+vkh_public
+VkhCmdAllocator vkh_cmd_allocator_create     (VkhDevice dev, uint32_t qFamIndex, uint32_t frameCount);
+vkh_public
+void            vkh_cmd_allocator_destroy    (VkhCmdAllocator ca);
+vkh_public
+VkCommandBuffer vkh_cmd_allocator_get        (VkhCmdAllocator ca, VkCommandBufferLevel level);
+vkh_public
+VkFence         vkh_cmd_allocator_get_fence  (VkhCmdAllocator ca);
+vkh_public
+uint32_t        vkh_cmd_allocator_get_frame  (VkhCmdAllocator ca);
+vkh_public
+void            vkh_cmd_allocator_next_frame (VkhCmdAllocator ca);
+
+/****************
+ * VkhJobSystem *
+ ****************/
+/**
+ * @brief Worker threads with work stealing deques, jobs pushed from other threads go through a shared queue.
+ * Waiting threads run pending jobs.
+ */
+vkh_public
+VkhJobSystem    vkh_jobs_create             (uint32_t workerCount);
+vkh_public
+void            vkh_jobs_destroy            (VkhJobSystem js);
+vkh_public
+uint32_t        vkh_jobs_get_worker_count   (VkhJobSystem js);
+vkh_public
+void            vkh_jobs_submit             (VkhJobSystem js, VkhJobFunc func, void* userData);
+vkh_public
+void            vkh_jobs_wait               (VkhJobSystem js);
+vkh_public
+void            vkh_jobs_parallel_for       (VkhJobSystem js, uint32_t count, uint32_t grain, VkhJobRangeFunc func, void* userData);
+vkh_public
+void            vkh_cmd_record_parallel     (VkhJobSystem js, VkhCmdAllocator ca, VkCommandBuffer primary,
+                                             const VkCommandBufferInheritanceInfo* inheritance, uint32_t count, uint32_t chunkSize,
+                                             VkhCmdRecordFunc func, void* userData);
 
 vkh_public
 void vkh_cmd_label_start   (VkCommandBuffer cmd, const char* name, const float color[4]);
@@ -371,6 +820,36 @@ vkh_public
 void vkh_cmd_label_end     (VkCommandBuffer cmd);
 vkh_public
 void vkh_cmd_label_insert  (VkCommandBuffer cmd, const char* name, const float color[4]);
+vkh_public
+void vkh_device_cmd_label_start (VkhDevice dev, VkCommandBuffer cmd, const char* name, const float color[4]);
+vkh_public
+void vkh_device_cmd_label_end   (VkhDevice dev, VkCommandBuffer cmd);
+
+/***************
+ * VkhProfiler *
+ ***************/
+/**
+ * @brief Opt-in GPU profiler attached to its device, regions labeled with vkh_device_cmd_label_start/end are timed
+ * with timestamp queries even without debug utils.
+ */
+vkh_public
+VkhProfiler vkh_profiler_create         (VkhDevice dev, uint32_t qFamIndex, uint32_t frameCount, uint32_t maxRegions);
+vkh_public
+void        vkh_profiler_destroy        (VkhProfiler prof);
+vkh_public
+void        vkh_profiler_begin_frame    (VkhProfiler prof, VkCommandBuffer cmd);
+vkh_public
+void        vkh_profiler_end_frame      (VkhProfiler prof);
+vkh_public
+void        vkh_profiler_collect        (VkhProfiler prof);
+vkh_public
+uint32_t    vkh_profiler_get_results    (VkhProfiler prof, VkhGpuRegion* regions, uint32_t maxRegions, uint64_t* pFrameIndex);
+vkh_public
+uint32_t    vkh_profiler_get_submits    (VkhProfiler prof, VkhGpuSubmit* submits, uint32_t maxSubmits, uint64_t* pFrameIndex);
+vkh_public
+void        vkh_profiler_set_capture    (VkhProfiler prof, bool capture);
+vkh_public
+bool        vkh_profiler_export_trace   (VkhProfiler prof, const char* path);
 
 vkh_public
 VkShaderModule vkh_load_module(VkDevice dev, const char* path);
@@ -397,9 +876,144 @@ vkh_public
 VkhQueue    vkh_queue_create    (VkhDevice dev, uint32_t familyIndex, uint32_t qIndex);
 vkh_public
 void        vkh_queue_destroy   (VkhQueue queue);
+/**
+ * @brief VkhQueue is internally synchronized, submissions may be enqueued from any thread and sent
+ * with a single vkQueueSubmit on flush or by the submit thread.
+ */
+vkh_public
+void        vkh_queue_lock      (VkhQueue queue);
+vkh_public
+void        vkh_queue_unlock    (VkhQueue queue);
+vkh_public
+VkResult    vkh_queue_submit    (VkhQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence);
+vkh_public
+void        vkh_queue_enqueue   (VkhQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence);
+vkh_public
+VkResult    vkh_queue_flush     (VkhQueue queue);
+vkh_public
+void        vkh_queue_start_submit_thread   (VkhQueue queue);
+vkh_public
+void        vkh_queue_stop_submit_thread    (VkhQueue queue);
+vkh_public
+uint64_t    vkh_queue_get_submit_time       (VkhQueue queue);
 //VkhQueue    vkh_queue_find      (VkhDevice dev, VkQueueFlags flags);
 /////////////////////
 
+/*******************
+ * VkhQueueManager *
+ *******************/
+/**
+ * @brief Own every queue created for a device, families are scored for each usage (dedicated transfer,
+ * async compute, present) and their queues handed out round robin or to the least leased one.
+ */
+vkh_public
+VkhQueueManager vkh_queue_manager_create    (VkhDevice dev, VkSurfaceKHR surface, const VkDeviceQueueCreateInfo* pQueueInfos,
+                                             uint32_t queueInfoCount, VkhQueueBalance balance);
+vkh_public
+void            vkh_queue_manager_destroy   (VkhQueueManager qm);
+vkh_public
+int             vkh_queue_manager_get_family(VkhQueueManager qm, VkhQueueUsage usage);
+vkh_public
+VkhQueue        vkh_queue_manager_acquire   (VkhQueueManager qm, VkhQueueUsage usage);
+vkh_public
+void            vkh_queue_manager_release   (VkhQueueManager qm, VkhQueue queue);
+
+/******************
+ * VkhRenderGraph *
+ ******************/
+/**
+ * @brief Passes declare the resources they read and write, the graph culls passes not contributing to an output,
+ * orders them, aliases transient resources memory and records the barriers and queue synchronization.
+ * Requires the timelineSemaphore feature.
+ */
+vkh_public
+VkhRenderGraph  vkh_render_graph_create         (VkhDevice dev);
+vkh_public
+void            vkh_render_graph_destroy        (VkhRenderGraph g);
+vkh_public
+uint32_t        vkh_render_graph_import_image   (VkhRenderGraph g, VkhImage img, VkImageAspectFlags aspectMask);
+vkh_public
+uint32_t        vkh_render_graph_import_buffer  (VkhRenderGraph g, VkhBuffer buff);
+vkh_public
+void            vkh_render_graph_update_image   (VkhRenderGraph g, uint32_t res, VkhImage img);
+vkh_public
+uint32_t        vkh_render_graph_create_image   (VkhRenderGraph g, VkFormat format, uint32_t width, uint32_t height,
+                                                 VkImageUsageFlags usage, VkImageAspectFlags aspectMask);
+vkh_public
+uint32_t        vkh_render_graph_create_buffer  (VkhRenderGraph g, VkBufferUsageFlags usage, VkDeviceSize size);
+vkh_public
+VkhImage        vkh_render_graph_get_image      (VkhRenderGraph g, uint32_t res);
+vkh_public
+VkhBuffer       vkh_render_graph_get_buffer     (VkhRenderGraph g, uint32_t res);
+vkh_public
+void            vkh_render_graph_set_output     (VkhRenderGraph g, uint32_t res, VkImageLayout finalLayout);
+vkh_public
+uint32_t        vkh_render_graph_add_pass       (VkhRenderGraph g, const char* name, VkhGraphQueue queue, VkhPassFunc func, void* userData);
+vkh_public
+void            vkh_render_graph_read           (VkhRenderGraph g, uint32_t pass, uint32_t res, VkImageLayout layout,
+                                                 VkPipelineStageFlags stages, VkAccessFlags access);
+vkh_public
+void            vkh_render_graph_write          (VkhRenderGraph g, uint32_t pass, uint32_t res, VkImageLayout layout,
+                                                 VkPipelineStageFlags stages, VkAccessFlags access);
+vkh_public
+VkResult        vkh_render_graph_compile        (VkhRenderGraph g);
+vkh_public
+bool            vkh_render_graph_is_culled      (VkhRenderGraph g, uint32_t pass);
+vkh_public
+VkResult        vkh_render_graph_execute        (VkhRenderGraph g, VkhQueue graphicsQueue, VkhQueue computeQueue,
+                                                 VkSemaphore waitSemaphore, VkPipelineStageFlags waitStages,
+                                                 VkSemaphore signalSemaphore, VkFence fence);
+
+/*****************
+ * VkhCompletion *
+ *****************/
+/**
+ * @brief Background thread waiting on many timelines and fences at once, completions run a callback on that
+ * thread or are queued as events for vkh_completion_poll. Requires the timelineSemaphore feature.
+ */
+vkh_public
+VkhCompletion   vkh_completion_create           (VkhDevice dev, uint32_t eventCapacity);
+vkh_public
+void            vkh_completion_destroy          (VkhCompletion cs);
+vkh_public
+void            vkh_completion_watch_timeline   (VkhCompletion cs, VkSemaphore timeline, uint64_t value,
+                                                 VkhCompletionFunc func, void* userData);
+vkh_public
+void            vkh_completion_watch_fence      (VkhCompletion cs, VkFence fence, VkhCompletionFunc func, void* userData);
+vkh_public
+bool            vkh_completion_poll             (VkhCompletion cs, VkhCompletionEvent* pEvent);
+vkh_public
+uint32_t        vkh_completion_get_pending      (VkhCompletion cs);
+
+/***************
+ * VkhTimeline *
+ ***************/
+/**
+ * @brief Timeline semaphore with a host side counter of reserved values and a cache of the last completed one.
+ * Deadlines are absolute vkh_host_time nanoseconds.
+ */
+vkh_public
+VkhTimeline vkh_timeline_object_create  (VkhDevice dev, uint64_t initialValue);
+vkh_public
+void        vkh_timeline_object_destroy (VkhTimeline tl);
+vkh_public
+VkSemaphore vkh_timeline_get_semaphore  (VkhTimeline tl);
+vkh_public
+uint64_t    vkh_timeline_reserve        (VkhTimeline tl, uint32_t count);
+vkh_public
+uint64_t    vkh_timeline_get_reserved   (VkhTimeline tl);
+vkh_public
+VkResult    vkh_timeline_signal         (VkhTimeline tl, uint64_t value);
+vkh_public
+uint64_t    vkh_timeline_get_completed  (VkhTimeline tl);
+vkh_public
+bool        vkh_timeline_is_done        (VkhTimeline tl, uint64_t value);
+vkh_public
+VkResult    vkh_timeline_wait_until     (VkhTimeline tl, uint64_t value, uint64_t deadline);
+vkh_public
+VkResult    vkh_timelines_wait          (uint32_t count, const VkhTimeline* timelines, const uint64_t* values, bool waitAll,
+                                         uint64_t deadline, uint32_t* pIndex);
+
 vkh_public
 bool vkh_instance_extension_supported (const char* instanceName);
 vkh_public
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vkh_alias.h"
+#include "vkh_device.h"
+#include "vkh_image.h"
+#include "vkh_buffer.h"
+#include "vkh_stats.h"
+
+#define ALIAS_POOL_INIT_SIZE	8
+
+#ifndef MAX
+# define MAX(a,b) (((a) > (b)) ? (a) : (b))
+#endif
+
+static VkDeviceSize _align_up (VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+static VkDeviceSize _align_down (VkDeviceSize value, VkDeviceSize alignment) {
+	return value / alignment * alignment;
+}
+static bool _lifetimes_overlap (const vkh_alias_entry_t* a, const vkh_alias_entry_t* b) {
+	return a->firstPass <= b->lastPass && b->firstPass <= a->lastPass;
+}
+static bool _memory_overlap (const vkh_alias_entry_t* a, const vkh_alias_entry_t* b) {
+	return a->offset < b->offset + b->memReq.size && b->offset < a->offset + a->memReq.size;
+}
+//biggest resources are placed first
+static int _compare_entries (const void* a, const void* b) {
+	VkDeviceSize sa = ((const vkh_alias_entry_t*)a)->memReq.size;
+	VkDeviceSize sb = ((const vkh_alias_entry_t*)b)->memReq.size;
+	return (sa < sb) - (sa > sb);
+}
+
+VkhAliasPool vkh_alias_pool_create (VkhDevice dev, VkhMemoryUsage memprops) {
+	VkhAliasPool pool = (VkhAliasPool)calloc(1, sizeof(vkh_alias_pool_t));
+	pool->dev		= dev;
+	pool->memprops	= memprops;
+	pool->reserved	= ALIAS_POOL_INIT_SIZE;
+	pool->entries	= (vkh_alias_entry_t*)malloc(pool->reserved * sizeof(vkh_alias_entry_t));
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties (dev->phy, &props);
+	pool->granularity = MAX(props.limits.bufferImageGranularity, 1);
+	return pool;
+}
+//free the shared memory, aliased resources have to be destroyed separately by their owner.
+void vkh_alias_pool_destroy (VkhAliasPool pool) {
+#ifdef VKH_USE_VMA
+	if (pool->alloc != VK_NULL_HANDLE) {
+		vmaFreeMemory (pool->dev->allocator, pool->alloc);
+		VKH_STAT_MEMORY_ADD(pool->memprops, -(int64_t)pool->size);
+	}
+#else
+	if (pool->memory != VK_NULL_HANDLE) {
+		vkFreeMemory (pool->dev->dev, pool->memory, NULL);
+		VKH_STAT_MEMORY_ADD(pool->memprops, -(int64_t)pool->size);
+	}
+#endif
+	free (pool->entries);
+	free (pool);
+}
+
+static vkh_alias_entry_t* _add_entry (VkhAliasPool pool, uint32_t firstPass, uint32_t lastPass) {
+	if (pool->count == pool->reserved) {
+		pool->reserved *= 2;
+		pool->entries = (vkh_alias_entry_t*)realloc(pool->entries, pool->reserved * sizeof(vkh_alias_entry_t));
+	}
+	vkh_alias_entry_t* e = &pool->entries[pool->count++];
+	memset (e, 0, sizeof(vkh_alias_entry_t));
+	e->firstPass	= firstPass;
+	e->lastPass		= lastPass;
+	return e;
+}
+/**
+ * @brief register an unbound image used from pass 'firstPass' to pass 'lastPass' (inclusive).
+ */
+void vkh_alias_pool_add_image (VkhAliasPool pool, VkhImage img, uint32_t firstPass, uint32_t lastPass) {
+	vkh_alias_entry_t* e = _add_entry (pool, firstPass, lastPass);
+	e->type		= VK_OBJECT_TYPE_IMAGE;
+	e->resource	= img;
+	e->linear	= img->infos.tiling == VK_IMAGE_TILING_LINEAR;
+	vkGetImageMemoryRequirements (pool->dev->dev, img->image, &e->memReq);
+}
+/**
+ * @brief register an unbound buffer used from pass 'firstPass' to pass 'lastPass' (inclusive).
+ */
+void vkh_alias_pool_add_buffer (VkhAliasPool pool, VkhBuffer buff, uint32_t firstPass, uint32_t lastPass) {
+	vkh_alias_entry_t* e = _add_entry (pool, firstPass, lastPass);
+	e->type		= VK_OBJECT_TYPE_BUFFER;
+	e->resource	= buff;
+	e->linear	= true;
+	vkGetBufferMemoryRequirements (pool->dev->dev, buff->buffer, &e->memReq);
+}
+
+//true if 'e' placed at 'offset' collides with an already placed resource alive at the same time.
+static bool _collides (VkhAliasPool pool, uint32_t placed, const vkh_alias_entry_t* e, VkDeviceSize offset) {
+	for (uint32_t i=0; i<placed; i++) {
+		const vkh_alias_entry_t* o = &pool->entries[i];
+		if (!_lifetimes_overlap (e, o))
+			continue;
+		VkDeviceSize start = o->offset, end = o->offset + o->memReq.size;
+		if (e->linear != o->linear) {
+			start	= _align_down (start, pool->granularity);
+			end		= _align_up (end, pool->granularity);
+		}
+		if (offset < end && start < offset + e->memReq.size)
+			return true;
+	}
+	return false;
+}
+/**
+ * @brief compute offsets of all the registered resources so that resources alive during the same passes
+ * never share memory, then allocate a single memory block and bind every resource to it.
+ * A pool is bound once: resources can not be bound twice, a new layout needs new resources and a new pool.
+ */
+VkResult vkh_alias_pool_bind (VkhAliasPool pool) {
+#ifdef VKH_USE_VMA
+	bool bound = pool->alloc != VK_NULL_HANDLE;
+#else
+	bool bound = pool->memory != VK_NULL_HANDLE;
+#endif
+	assert (!bound && "alias pool already bound");
+	if (bound)
+		return VK_ERROR_INITIALIZATION_FAILED;
+	if (pool->count == 0)
+		return VK_SUCCESS;
+
+	qsort (pool->entries, pool->count, sizeof(vkh_alias_entry_t), _compare_entries);
+
+	uint32_t memoryTypeBits = UINT32_MAX;
+	VkDeviceSize maxAlignment = 1;
+	pool->size = 0;
+
+	for (uint32_t i=0; i<pool->count; i++) {
+		vkh_alias_entry_t* e = &pool->entries[i];
+		memoryTypeBits &= e->memReq.memoryTypeBits;
+		maxAlignment = MAX(maxAlignment, e->memReq.alignment);
+
+		//candidate offsets are the start of the block and the end of every live placed resource
+		VkDeviceSize best = UINT64_MAX;
+		for (uint32_t j=0; j<=i; j++) {
+			VkDeviceSize candidate = 0;
+			if (j < i) {
+				const vkh_alias_entry_t* o = &pool->entries[j];
+				if (!_lifetimes_overlap (e, o))
+					continue;
+				candidate = o->offset + o->memReq.size;
+				if (e->linear != o->linear)
+					candidate = _align_up (candidate, pool->granularity);
+			}
+			candidate = _align_up (candidate, e->memReq.alignment);
+			if (candidate < best && !_collides (pool, i, e, candidate))
+				best = candidate;
+		}
+		e->offset = best;
+		pool->size = MAX(pool->size, e->offset + e->memReq.size);
+	}
+
+	if (memoryTypeBits == 0) {
+		fprintf (stderr, "No memory type compatible with all aliased resources\n");
+		return VK_ERROR_FEATURE_NOT_PRESENT;
+	}
+
+	VkMemoryRequirements memReq = { .size = pool->size, .alignment = maxAlignment, .memoryTypeBits = memoryTypeBits };
+#ifdef VKH_USE_VMA
+	VmaAllocationCreateInfo allocCreateInfo = { .usage = (VmaMemoryUsage)pool->memprops };
+	VkResult res;
+	VKH_STAT_ALLOCATION(res = vmaAllocateMemory (pool->dev->allocator, &memReq, &allocCreateInfo, &pool->alloc, NULL));
+	if (res != VK_SUCCESS)
+		return res;
+#else
+	VkDevice dev = pool->dev->dev;
+	VkMemoryAllocateInfo memAllocInfo = { .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+										  .allocationSize = memReq.size };
+	if (!vkh_memory_type_from_properties (&pool->dev->phyMemProps, memReq.memoryTypeBits, pool->memprops, &memAllocInfo.memoryTypeIndex))
+		return VK_ERROR_FEATURE_NOT_PRESENT;
+	VkResult res;
+	VKH_STAT_ALLOCATION(res = vkAllocateMemory (dev, &memAllocInfo, NULL, &pool->memory));
+	if (res != VK_SUCCESS)
+		return res;
+#endif
+	VKH_STAT_MEMORY_ADD(pool->memprops, pool->size);
+
+	for (uint32_t i=0; i<pool->count; i++) {
+		vkh_alias_entry_t* e = &pool->entries[i];
+		if (e->type == VK_OBJECT_TYPE_IMAGE) {
+			VkhImage img = (VkhImage)e->resource;
+#ifdef VKH_USE_VMA
+			VK_CHECK_RESULT(vmaBindImageMemory2 (pool->dev->allocator, pool->alloc, e->offset, img->image, NULL));
+#else
+			VK_CHECK_RESULT(vkBindImageMemory (dev, img->image, pool->memory, e->offset));
+#endif
+		} else {
+			VkhBuffer buff = (VkhBuffer)e->resource;
+#ifdef VKH_USE_VMA
+			VK_CHECK_RESULT(vmaBindBufferMemory2 (pool->dev->allocator, pool->alloc, e->offset, buff->buffer, NULL));
+#else
+			VK_CHECK_RESULT(vkBindBufferMemory (dev, buff->buffer, pool->memory, e->offset));
+#endif
+		}
+	}
+	return VK_SUCCESS;
+}
+VkDeviceSize vkh_alias_pool_get_size (VkhAliasPool pool) {
+	return pool->size;
+}
+//memory that would be needed without aliasing.
+VkDeviceSize vkh_alias_pool_get_unaliased_size (VkhAliasPool pool) {
+	VkDeviceSize size = 0;
+	for (uint32_t i=0; i<pool->count; i++)
+		size += pool->entries[i].memReq.size;
+	return size;
+}
+/**
+ * @brief record the aliasing barrier needed before 'pass': resources starting their lifetime in this pass
+ * and sharing memory with another resource have undefined content, the barrier is only recorded when one
+ * of those resources ended its lifetime in a previous pass. Their tracked layout is reset to
+ * VK_IMAGE_LAYOUT_UNDEFINED so that the first vkh_image_set_layout discards the previous content.
+ */
+void vkh_alias_pool_cmd_barriers (VkhAliasPool pool, VkCommandBuffer cmd, uint32_t pass) {
+	bool aliased = false;
+	for (uint32_t i=0; i<pool->count; i++) {
+		vkh_alias_entry_t* e = &pool->entries[i];
+		if (e->firstPass != pass)
+			continue;
+		//later users of the same memory overwrote the content during the previous frame,
+		//only the ones that ended before this pass need to be waited on.
+		bool overlap = false, predecessor = false;
+		for (uint32_t j=0; j<pool->count && !predecessor; j++) {
+			if (i == j || !_memory_overlap (e, &pool->entries[j]))
+				continue;
+			overlap = true;
+			predecessor = pool->entries[j].lastPass < pass;
+		}
+		if (!overlap)
+			continue;
+		aliased |= predecessor;
+		if (e->type == VK_OBJECT_TYPE_IMAGE)
+			((VkhImage)e->resource)->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+	if (!aliased)
+		return;
+	VkMemoryBarrier barrier = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+								.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+								.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT };
+	vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+						  1, &barrier, 0, NULL, 0, NULL);
+	VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
+}
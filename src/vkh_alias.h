@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef VKH_ALIAS_H
+#define VKH_ALIAS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "vkh.h"
+
+#ifdef VKH_USE_VMA
+#include "vk_mem_alloc.h"
+#endif
+
+typedef struct {
+	VkObjectType			type;		//VK_OBJECT_TYPE_IMAGE or VK_OBJECT_TYPE_BUFFER
+	void*					resource;	//VkhImage or VkhBuffer
+	VkMemoryRequirements	memReq;
+	bool					linear;		//linear resources and optimal images have to respect bufferImageGranularity
+	uint32_t				firstPass;
+	uint32_t				lastPass;
+	VkDeviceSize			offset;
+}vkh_alias_entry_t;
+
+typedef struct _vkh_alias_pool_t {
+	VkhDevice				dev;
+	VkhMemoryUsage			memprops;
+	VkDeviceSize			granularity;
+	vkh_alias_entry_t*		entries;
+	uint32_t				count;
+	uint32_t				reserved;
+	VkDeviceSize			size;		//size of the shared allocation once bound
+#ifdef VKH_USE_VMA
+	VmaAllocation			alloc;
+#else
+	VkDeviceMemory			memory;
+#endif
+}vkh_alias_pool_t;
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef VKH_ATOMIC_H
+#define VKH_ATOMIC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//C11 atomics subset used by vkh. Msvc has no <stdatomic.h>, operations map to the Interlocked functions which
+//are full barriers, memory orders are ignored. Atomic integers are 32 or 64 bits wide there.
+
+#include "deps/tinycthread.h"//_Thread_local
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+
+#include <windows.h>
+
+typedef volatile LONG		vkh_atomic_bool;
+typedef volatile LONG		vkh_atomic_int;
+typedef volatile LONG		vkh_atomic_uint;
+typedef volatile LONG64		vkh_atomic_llong;
+typedef volatile LONG64		vkh_atomic_ullong;
+#define vkh_atomic_ptr(T)	T volatile
+
+#define vkh_memory_order_relaxed	0
+#define vkh_memory_order_acquire	0
+#define vkh_memory_order_release	0
+#define vkh_memory_order_seq_cst	0
+
+static __inline LONG64 _vkh_atomic_load (volatile void* p, size_t size) {
+	if (size == 8)
+		return InterlockedCompareExchange64 ((volatile LONG64*)p, 0, 0);
+	return InterlockedCompareExchange ((volatile LONG*)p, 0, 0);
+}
+static __inline void _vkh_atomic_store (volatile void* p, size_t size, LONG64 value) {
+	if (size == 8)
+		InterlockedExchange64 ((volatile LONG64*)p, value);
+	else
+		InterlockedExchange ((volatile LONG*)p, (LONG)value);
+}
+static __inline LONG64 _vkh_atomic_fetch_add (volatile void* p, size_t size, LONG64 value) {
+	if (size == 8)
+		return InterlockedExchangeAdd64 ((volatile LONG64*)p, value);
+	return InterlockedExchangeAdd ((volatile LONG*)p, (LONG)value);
+}
+//'expected' may be narrower than the atomic (bool for ex.)
+static __inline bool _vkh_atomic_cas (volatile void* p, size_t size, void* expected, size_t expectedSize, LONG64 desired) {
+	LONG64 exp = expectedSize == 8 ? *(LONG64*)expected :
+				 expectedSize == 4 ? *(LONG*)expected :
+				 expectedSize == 2 ? *(SHORT*)expected : *(CHAR*)expected;
+	LONG64 old;
+	bool done;
+	if (size == 8) {
+		old = InterlockedCompareExchange64 ((volatile LONG64*)p, desired, exp);
+		done = old == exp;
+	} else {
+		old = InterlockedCompareExchange ((volatile LONG*)p, (LONG)desired, (LONG)exp);
+		done = (LONG)old == (LONG)exp;
+	}
+	if (done)
+		return true;
+	switch (expectedSize) {
+	case 8: *(LONG64*)expected = old; break;
+	case 4: *(LONG*)expected = (LONG)old; break;
+	case 2: *(SHORT*)expected = (SHORT)old; break;
+	default: *(CHAR*)expected = (CHAR)old; break;
+	}
+	return false;
+}
+static __inline bool _vkh_atomic_cas_ptr (PVOID volatile* p, PVOID* expected, PVOID desired) {
+	PVOID old = InterlockedCompareExchangePointer (p, desired, *expected);
+	if (old == *expected)
+		return true;
+	*expected = old;
+	return false;
+}
+
+#define vkh_atomic_init(p, v)						(*(p) = (v))
+#define vkh_atomic_load_explicit(p, o)				_vkh_atomic_load ((p), sizeof(*(p)))
+#define vkh_atomic_store_explicit(p, v, o)			_vkh_atomic_store ((p), sizeof(*(p)), (LONG64)(v))
+#define vkh_atomic_fetch_add_explicit(p, v, o)		_vkh_atomic_fetch_add ((p), sizeof(*(p)), (LONG64)(v))
+#define vkh_atomic_fetch_sub_explicit(p, v, o)		_vkh_atomic_fetch_add ((p), sizeof(*(p)), -(LONG64)(v))
+#define vkh_atomic_compare_exchange_strong_explicit(p, e, v, s, f)	\
+	_vkh_atomic_cas ((p), sizeof(*(p)), (e), sizeof(*(e)), (LONG64)(v))
+#define vkh_atomic_compare_exchange_weak_explicit(p, e, v, s, f)	\
+	_vkh_atomic_cas ((p), sizeof(*(p)), (e), sizeof(*(e)), (LONG64)(v))
+#define vkh_atomic_thread_fence(o)					MemoryBarrier ()
+
+#define vkh_atomic_ptr_load_explicit(p, o)			InterlockedCompareExchangePointer ((PVOID volatile*)(p), NULL, NULL)
+#define vkh_atomic_ptr_store_explicit(p, v, o)		(void)InterlockedExchangePointer ((PVOID volatile*)(p), (PVOID)(v))
+#define vkh_atomic_ptr_compare_exchange_weak(p, e, v)	\
+	_vkh_atomic_cas_ptr ((PVOID volatile*)(p), (PVOID*)(e), (PVOID)(v))
+
+#else
+
+#include <stdatomic.h>
+
+typedef atomic_bool			vkh_atomic_bool;
+typedef atomic_int			vkh_atomic_int;
+typedef atomic_uint			vkh_atomic_uint;
+typedef atomic_llong		vkh_atomic_llong;
+typedef atomic_ullong		vkh_atomic_ullong;
+#define vkh_atomic_ptr(T)	_Atomic(T)
+
+#define vkh_memory_order_relaxed	memory_order_relaxed
+#define vkh_memory_order_acquire	memory_order_acquire
+#define vkh_memory_order_release	memory_order_release
+#define vkh_memory_order_seq_cst	memory_order_seq_cst
+
+#define vkh_atomic_init(p, v)						atomic_init (p, v)
+#define vkh_atomic_load_explicit(p, o)				atomic_load_explicit (p, o)
+#define vkh_atomic_store_explicit(p, v, o)			atomic_store_explicit (p, v, o)
+#define vkh_atomic_fetch_add_explicit(p, v, o)		atomic_fetch_add_explicit (p, v, o)
+#define vkh_atomic_fetch_sub_explicit(p, v, o)		atomic_fetch_sub_explicit (p, v, o)
+#define vkh_atomic_compare_exchange_strong_explicit(p, e, v, s, f)	\
+	atomic_compare_exchange_strong_explicit (p, e, v, s, f)
+#define vkh_atomic_compare_exchange_weak_explicit(p, e, v, s, f)	\
+	atomic_compare_exchange_weak_explicit (p, e, v, s, f)
+#define vkh_atomic_thread_fence(o)					atomic_thread_fence (o)
+
+#define vkh_atomic_ptr_load_explicit(p, o)			atomic_load_explicit (p, o)
+#define vkh_atomic_ptr_store_explicit(p, v, o)		atomic_store_explicit (p, v, o)
+#define vkh_atomic_ptr_compare_exchange_weak(p, e, v)	atomic_compare_exchange_weak (p, e, v)
+
+#endif
+
+//sequentially consistent shorthands
+#define vkh_atomic_load(p)							vkh_atomic_load_explicit (p, vkh_memory_order_seq_cst)
+#define vkh_atomic_store(p, v)						vkh_atomic_store_explicit (p, v, vkh_memory_order_seq_cst)
+#define vkh_atomic_fetch_add(p, v)					vkh_atomic_fetch_add_explicit (p, v, vkh_memory_order_seq_cst)
+#define vkh_atomic_fetch_sub(p, v)					vkh_atomic_fetch_sub_explicit (p, v, vkh_memory_order_seq_cst)
+#define vkh_atomic_compare_exchange_strong(p, e, v)	\
+	vkh_atomic_compare_exchange_strong_explicit (p, e, v, vkh_memory_order_seq_cst, vkh_memory_order_seq_cst)
+#define vkh_atomic_compare_exchange_weak(p, e, v)	\
+	vkh_atomic_compare_exchange_weak_explicit (p, e, v, vkh_memory_order_seq_cst, vkh_memory_order_seq_cst)
+#define vkh_atomic_ptr_load(p)						vkh_atomic_ptr_load_explicit (p, vkh_memory_order_seq_cst)
+
+#ifdef __cplusplus
+}
+#endif
+#endif
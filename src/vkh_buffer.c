@@ -21,6 +21,7 @@
  */
 #include "vkh_buffer.h"
 #include "vkh_device.h"
+#include "vkh_stats.h"
 
 #ifndef VKH_USE_VMA
 void _set_size_and_bind(VkhDevice pDev, VkBufferUsageFlags usage, VkhMemoryUsage memoryUsage, VkDeviceSize size, VkhBuffer buff){
@@ -29,7 +30,7 @@ void _set_size_and_bind(VkhDevice pDev, VkBufferUsageFlags usage, VkhMemoryUsage
 	VkMemoryAllocateInfo memAllocInfo = { .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
 										  .allocationSize = memReq.size };
 	assert(vkh_memory_type_from_properties(&pDev->phyMemProps, memReq.memoryTypeBits, memoryUsage, &memAllocInfo.memoryTypeIndex) == true);
-	VK_CHECK_RESULT(vkAllocateMemory(pDev->dev, &memAllocInfo, NULL, &buff->memory));
+	VKH_STAT_ALLOCATION(VK_CHECK_RESULT(vkAllocateMemory(pDev->dev, &memAllocInfo, NULL, &buff->memory)));
 
 	buff->alignment = memReq.alignment;
 	buff->size = memAllocInfo.allocationSize;
@@ -39,9 +40,21 @@ void _set_size_and_bind(VkhDevice pDev, VkBufferUsageFlags usage, VkhMemoryUsage
 	VK_CHECK_RESULT(vkBindBufferMemory(buff->pDev->dev, buff->buffer, buff->memory, 0));
 }
 #endif
+//account memory owned by the buffer, sign is 1 on allocation and -1 on release.
+static void _stat_memory (VkhBuffer buff, int sign) {
+#ifdef VKH_USE_VMA
+	if (buff->alloc != VK_NULL_HANDLE)
+		VKH_STAT_MEMORY_ADD(buff->allocCreateInfo.usage, sign * (int64_t)buff->allocInfo.size);
+#else
+	if (buff->memory != VK_NULL_HANDLE)
+		VKH_STAT_MEMORY_ADD(buff->memprops, sign * (int64_t)buff->size);
+#endif
+}
 
 void vkh_buffer_init(VkhDevice pDev, VkBufferUsageFlags usage, VkhMemoryUsage memprops, VkDeviceSize size, VkhBuffer buff, bool mapped){
 	buff->pDev			= pDev;
+	vkh_atomic_init (&buff->references, 1);
+	buff->ownerFamily = buff->releaseFamily = buff->acquireFamily = VK_QUEUE_FAMILY_IGNORED;
 	VkBufferCreateInfo* pInfo = &buff->infos;
 	pInfo->sType		= VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	pInfo->usage		= usage;
@@ -51,7 +64,7 @@ void vkh_buffer_init(VkhDevice pDev, VkBufferUsageFlags usage, VkhMemoryUsage me
 	buff->allocCreateInfo.usage	= (VmaMemoryUsage)memprops;
 	if (mapped)
 		buff->allocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
-	VK_CHECK_RESULT(vmaCreateBuffer(pDev->allocator, pInfo, &buff->allocCreateInfo, &buff->buffer, &buff->alloc, &buff->allocInfo));
+	VKH_STAT_ALLOCATION(VK_CHECK_RESULT(vmaCreateBuffer(pDev->allocator, pInfo, &buff->allocCreateInfo, &buff->buffer, &buff->alloc, &buff->allocInfo)));
 #else
 	VK_CHECK_RESULT(vkCreateBuffer(pDev->dev, pInfo, NULL, &buff->buffer));	
 	_set_size_and_bind (pDev, usage, memprops, size, buff);
@@ -59,6 +72,8 @@ void vkh_buffer_init(VkhDevice pDev, VkBufferUsageFlags usage, VkhMemoryUsage me
 	if (mapped)
 		VK_CHECK_RESULT(vkMapMemory(buff->pDev->dev, buff->memory, 0, VK_WHOLE_SIZE, 0, &buff->mapped));
 #endif
+	_stat_memory (buff, 1);
+	VKH_STAT_ADD(VKH_STAT_BUFFERS, 1);
 }
 
 VkhBuffer vkh_buffer_create(VkhDevice pDev, VkBufferUsageFlags usage, VkhMemoryUsage memprops, VkDeviceSize size){
@@ -67,7 +82,27 @@ VkhBuffer vkh_buffer_create(VkhDevice pDev, VkBufferUsageFlags usage, VkhMemoryU
 	return buff;
 }
 
-void vkh_buffer_reset(VkhBuffer buff){
+//create a VkBuffer with no memory bound, memory has to be provided later, for ex. by a VkhAliasPool
+VkhBuffer vkh_buffer_create_unbound(VkhDevice pDev, VkBufferUsageFlags usage, VkDeviceSize size){
+	VkhBuffer buff = (VkhBuffer)calloc(1, sizeof(vkh_buffer_t));
+	buff->pDev			= pDev;
+	vkh_atomic_init (&buff->references, 1);
+	buff->ownerFamily = buff->releaseFamily = buff->acquireFamily = VK_QUEUE_FAMILY_IGNORED;
+	VkBufferCreateInfo* pInfo = &buff->infos;
+	pInfo->sType		= VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	pInfo->usage		= usage;
+	pInfo->size			= size;
+	pInfo->sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+	VK_CHECK_RESULT(vkCreateBuffer(pDev->dev, pInfo, NULL, &buff->buffer));
+#ifndef VKH_USE_VMA
+	buff->usageFlags	= usage;
+#endif
+	VKH_STAT_ADD(VKH_STAT_BUFFERS, 1);
+	return buff;
+}
+
+static void _reset (VkhBuffer buff){
+	_stat_memory (buff, -1);
 	if (buff->buffer)
 #ifdef VKH_USE_VMA
 		vmaDestroyBuffer(buff->pDev->allocator, buff->buffer, buff->alloc);
@@ -77,10 +112,91 @@ void vkh_buffer_reset(VkhBuffer buff){
 		vkFreeMemory(buff->pDev->dev, buff->memory, NULL);
 #endif
 }
-void vkh_buffer_destroy(VkhBuffer buff){
+void vkh_buffer_reset(VkhBuffer buff){
+	_reset (buff);
+	VKH_STAT_ADD(VKH_STAT_BUFFERS, -1);
+}
+/**
+ * @brief record the release half of a queue family ownership transfer of an exclusive buffer to 'dstFamily'.
+ * Must be followed by @ref vkh_buffer_cmd_acquire on a queue of 'dstFamily' after a semaphore signaled by the
+ * submission of 'cmd'. Nothing is recorded if the content has no owner yet or is already owned by 'dstFamily'.
+ */
+void vkh_buffer_cmd_release (VkhBuffer buff, VkCommandBuffer cmd, uint32_t dstFamily, VkPipelineStageFlags srcStages) {
+	buff->acquireFamily = dstFamily;
+	if (buff->ownerFamily == VK_QUEUE_FAMILY_IGNORED || buff->ownerFamily == dstFamily) {
+		buff->releaseFamily = VK_QUEUE_FAMILY_IGNORED;
+		return;
+	}
+	buff->releaseFamily = buff->ownerFamily;
+	VkBufferMemoryBarrier barrier = { .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+									  .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+									  .srcQueueFamilyIndex = buff->releaseFamily,
+									  .dstQueueFamilyIndex = dstFamily,
+									  .buffer = buff->buffer,
+									  .size = VK_WHOLE_SIZE };
+	vkCmdPipelineBarrier (cmd, srcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
+	VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
+}
+/**
+ * @brief record the acquire half of the transfer started with @ref vkh_buffer_cmd_release. If there was no release,
+ * nothing is recorded and only the owner is updated.
+ */
+void vkh_buffer_cmd_acquire (VkhBuffer buff, VkCommandBuffer cmd, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+	if (buff->releaseFamily != VK_QUEUE_FAMILY_IGNORED) {
+		VkBufferMemoryBarrier barrier = { .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+										  .dstAccessMask = dstAccess,
+										  .srcQueueFamilyIndex = buff->releaseFamily,
+										  .dstQueueFamilyIndex = buff->acquireFamily,
+										  .buffer = buff->buffer,
+										  .size = VK_WHOLE_SIZE };
+		vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0, 0, NULL, 1, &barrier, 0, NULL);
+		VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
+	}
+	buff->ownerFamily	= buff->acquireFamily;
+	buff->releaseFamily	= VK_QUEUE_FAMILY_IGNORED;
+}
+/**
+ * @brief first half of a split barrier, signal 'evt' right after the last write of the buffer.
+ * Must be followed by @ref vkh_buffer_cmd_wait before the next use, in the same queue.
+ */
+void vkh_buffer_cmd_signal (VkhBuffer buff, VkCommandBuffer cmd, VkEvent evt, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+							VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+	buff->splitBarrier = (VkBufferMemoryBarrier) { .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+												   .srcAccessMask = srcAccess,
+												   .dstAccessMask = dstAccess,
+												   .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+												   .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+												   .buffer = buff->buffer,
+												   .size = VK_WHOLE_SIZE };
+	buff->splitSrcStages = srcStages;
+	buff->splitDstStages = dstStages;
+	vkh_cmd_split_barrier (buff->pDev, cmd, evt, false, srcStages, dstStages, &buff->splitBarrier, NULL);
+}
+//second half of the split barrier, 'evt' is reset afterward.
+void vkh_buffer_cmd_wait (VkhBuffer buff, VkCommandBuffer cmd, VkEvent evt) {
+	vkh_cmd_split_barrier (buff->pDev, cmd, evt, true, buff->splitSrcStages, buff->splitDstStages, &buff->splitBarrier, NULL);
+}
+void vkh_buffer_set_owner_family (VkhBuffer buff, uint32_t qFamIndex) {
+	buff->ownerFamily = qFamIndex;
+}
+uint32_t vkh_buffer_get_owner_family (VkhBuffer buff) {
+	return buff->ownerFamily;
+}
+void vkh_buffer_reference(VkhBuffer buff){
+	vkh_atomic_fetch_add_explicit (&buff->references, 1, vkh_memory_order_relaxed);
+}
+static void _vkh_buffer_free (VkhBuffer buff) {
+	_stat_memory (buff, -1);
+	VKH_STAT_ADD(VKH_STAT_BUFFERS, -1);
+
 	if (buff->buffer)
 #ifdef VKH_USE_VMA
-		vmaDestroyBuffer(buff->pDev->allocator, buff->buffer, buff->alloc);
+	{
+		if (buff->alloc == VK_NULL_HANDLE)//memory not owned (unbound or aliased)
+			vkDestroyBuffer(buff->pDev->dev, buff->buffer, NULL);
+		else
+			vmaDestroyBuffer(buff->pDev->allocator, buff->buffer, buff->alloc);
+	}
 #else
 		vkDestroyBuffer(buff->pDev->dev, buff->buffer, NULL);
 	if (buff->memory)
@@ -89,17 +205,38 @@ void vkh_buffer_destroy(VkhBuffer buff){
 	free(buff);
 	buff = NULL;
 }
+static void _vkh_buffer_release (VkhBuffer buff, bool recycle) {
+	if (!recycle)
+		buff->unrecyclable = true;
+	if (vkh_atomic_fetch_sub_explicit (&buff->references, 1, vkh_memory_order_release) > 1)
+		return;
+	vkh_atomic_thread_fence (vkh_memory_order_acquire);
+
+	if (!buff->unrecyclable && vkh_device_release_hook (buff->pDev, VK_OBJECT_TYPE_BUFFER, buff)) {
+		vkh_atomic_store_explicit (&buff->references, 1, vkh_memory_order_relaxed);
+		return;
+	}
+	_vkh_buffer_free (buff);
+}
+void vkh_buffer_destroy(VkhBuffer buff){
+	_vkh_buffer_release (buff, true);
+}
+//release a reference without ever handing the buffer to the release hook, see vkh_image_destroy_force.
+void vkh_buffer_destroy_force (VkhBuffer buff){
+	_vkh_buffer_release (buff, false);
+}
 void vkh_buffer_resize(VkhBuffer buff, VkDeviceSize newSize, bool mapped){
-	vkh_buffer_reset(buff);
+	_reset (buff);
 	buff->infos.size = newSize;
 #ifdef VKH_USE_VMA
-	VK_CHECK_RESULT(vmaCreateBuffer(buff->pDev->allocator, &buff->infos, &buff->allocCreateInfo, &buff->buffer, &buff->alloc, &buff->allocInfo));
+	VKH_STAT_ALLOCATION(VK_CHECK_RESULT(vmaCreateBuffer(buff->pDev->allocator, &buff->infos, &buff->allocCreateInfo, &buff->buffer, &buff->alloc, &buff->allocInfo)));
 #else
 	VK_CHECK_RESULT(vkCreateBuffer(buff->pDev->dev, &buff->infos, NULL, &buff->buffer));
 	_set_size_and_bind (buff->pDev, buff->usageFlags, buff->memprops, buff->infos.size, buff);
 	if (mapped)
 		VK_CHECK_RESULT(vkMapMemory(buff->pDev->dev, buff->memory, 0, VK_WHOLE_SIZE, 0, &buff->mapped));
 #endif
+	_stat_memory (buff, 1);
 }
 
 VkDescriptorBufferInfo vkh_buffer_get_descriptor (VkhBuffer buff){
@@ -145,3 +282,10 @@ void vkh_buffer_flush (VkhBuffer buff){
 #else
 #endif
 }
+//make device writes visible to the host for non coherent memory.
+void vkh_buffer_invalidate (VkhBuffer buff){
+#ifdef VKH_USE_VMA
+	vmaInvalidateAllocation (buff->pDev->allocator, buff->alloc, buff->allocInfo.offset, buff->allocInfo.size);
+#else
+#endif
+}
@@ -27,6 +27,7 @@ extern "C" {
 #endif
 
 #include "vkh.h"
+#include "vkh_atomic.h"
 
 #ifdef VKH_USE_VMA
 #include "vk_mem_alloc.h"
@@ -49,6 +50,14 @@ typedef struct _vkh_buffer_t {
 	VkDescriptorBufferInfo	descriptor;
 	VkDeviceSize			alignment;
 	void*					mapped;
+	uint32_t				ownerFamily;//queue family owning the buffer content, VK_QUEUE_FAMILY_IGNORED if unknown
+	uint32_t				releaseFamily;//family released by vkh_buffer_cmd_release, VK_QUEUE_FAMILY_IGNORED if no release barrier
+	uint32_t				acquireFamily;//family the pending transfer targets
+	VkBufferMemoryBarrier	splitBarrier;//pending split barrier signaled by vkh_buffer_cmd_signal
+	VkPipelineStageFlags	splitSrcStages;
+	VkPipelineStageFlags	splitDstStages;
+	vkh_atomic_uint			references;
+	bool					unrecyclable;//released by its owner with vkh_buffer_destroy_force, the release hook is skipped
 }vkh_buffer_t;
 #ifdef __cplusplus
 }
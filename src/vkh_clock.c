@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+# define _POSIX_C_SOURCE 199309L
+#endif
+#include "vkh_device.h"
+#include "vkh_queue.h"
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+
+#define CALIBRATION_SAMPLES	8
+
+/**
+ * @brief host clock in nanoseconds, CLOCK_MONOTONIC on posix and QueryPerformanceCounter on windows,
+ * the host time domain used for calibration.
+ */
+uint64_t vkh_host_time () {
+#ifdef _WIN32
+	LARGE_INTEGER counter, freq;
+	QueryPerformanceCounter (&counter);
+	QueryPerformanceFrequency (&freq);
+	return (uint64_t)((double)counter.QuadPart * 1000000000.0 / (double)freq.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+#ifdef VK_EXT_calibrated_timestamps
+# ifdef _WIN32
+#  define HOST_TIME_DOMAIN	VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT
+# else
+#  define HOST_TIME_DOMAIN	VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT
+# endif
+static bool _host_domain_supported (VkhDevice dev) {
+	PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT GetDomains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)
+			vkGetInstanceProcAddr (dev->instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+	if (GetDomains == NULL)
+		return false;
+	uint32_t count = 0;
+	GetDomains (dev->phy, &count, NULL);
+	VkTimeDomainEXT* domains = (VkTimeDomainEXT*)malloc(count * sizeof(VkTimeDomainEXT));
+	GetDomains (dev->phy, &count, domains);
+	bool host = false, device = false;
+	for (uint32_t i=0; i<count; i++) {
+		host |= domains[i] == HOST_TIME_DOMAIN;
+		device |= domains[i] == VK_TIME_DOMAIN_DEVICE_EXT;
+	}
+	free (domains);
+	return host && device;
+}
+//sample both clocks together, the sample with the smallest deviation is kept.
+static bool _calibrate_ext (VkhDevice dev) {
+	if (dev->GetCalibratedTimestampsEXT == NULL || !_host_domain_supported (dev))
+		return false;
+	VkCalibratedTimestampInfoEXT infos[2] = {
+		{ .sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, .timeDomain = VK_TIME_DOMAIN_DEVICE_EXT },
+		{ .sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, .timeDomain = HOST_TIME_DOMAIN }};
+	uint64_t bestDeviation = UINT64_MAX;
+	for (uint32_t i=0; i<CALIBRATION_SAMPLES; i++) {
+		uint64_t ts[2], deviation;
+		if (dev->GetCalibratedTimestampsEXT (dev->dev, 2, infos, ts, &deviation) != VK_SUCCESS)
+			return false;
+		if (deviation >= bestDeviation)
+			continue;
+# ifdef _WIN32
+		LARGE_INTEGER freq;
+		QueryPerformanceFrequency (&freq);
+		ts[1] = (uint64_t)((double)ts[1] * 1000000000.0 / (double)freq.QuadPart);
+# endif
+		bestDeviation = deviation;
+		dev->clockOffset = (int64_t)ts[1] - (int64_t)((double)ts[0] * dev->timestampPeriod);
+	}
+	dev->clockDeviation = bestDeviation;
+	return true;
+}
+#endif
+
+/**
+ * @brief without the extension, a timestamp is written on 'queue' and its fence polled. The GPU time
+ * lies between the host times before submission and after the fence is seen signaled, intervals of
+ * all samples are intersected.
+ */
+static bool _calibrate_fence (VkhDevice dev, VkhQueue queue) {
+	VkDevice vkDev = dev->dev;
+	VkCommandPool pool = vkh_cmd_pool_create (dev, queue->familyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	VkCommandBuffer cmd = vkh_cmd_buff_create (dev, pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	VkFence fence = vkh_fence_create (dev);
+	VkQueryPool query;
+	VkQueryPoolCreateInfo queryInfo = { .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+										.queryType = VK_QUERY_TYPE_TIMESTAMP,
+										.queryCount = 1 };
+	VK_CHECK_RESULT(vkCreateQueryPool (vkDev, &queryInfo, NULL, &query));
+
+	int64_t low = INT64_MIN, high = INT64_MAX;
+	int64_t bestOffset = 0, bestWidth = INT64_MAX;
+	bool result = true;
+	for (uint32_t i=0; i<CALIBRATION_SAMPLES && result; i++) {
+		vkh_cmd_begin (cmd, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		vkCmdResetQueryPool (cmd, query, 0, 1);
+		vkCmdWriteTimestamp (cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query, 0);
+		vkh_cmd_end (cmd);
+		VkSubmitInfo submit = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+								.commandBufferCount = 1,
+								.pCommandBuffers = &cmd };
+		uint64_t before = vkh_host_time ();
+		if (vkh_queue_submit (queue, 1, &submit, fence) != VK_SUCCESS) {
+			result = false;
+			break;
+		}
+		VkResult status;
+		while ((status = vkGetFenceStatus (vkDev, fence)) == VK_NOT_READY);
+		uint64_t after = vkh_host_time ();
+		uint64_t ticks = 0;
+		if (status != VK_SUCCESS ||
+				vkGetQueryPoolResults (vkDev, query, 0, 1, sizeof(uint64_t), &ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+			result = false;
+			break;
+		}
+		int64_t gpu = (int64_t)((double)ticks * dev->timestampPeriod);
+		int64_t lo = (int64_t)before - gpu, hi = (int64_t)after - gpu;
+		low = lo > low ? lo : low;
+		high = hi < high ? hi : high;
+		if (hi - lo < bestWidth) {
+			bestWidth = hi - lo;
+			bestOffset = lo + (hi - lo) / 2;
+		}
+		vkResetFences (vkDev, 1, &fence);
+	}
+	if (result) {
+		//intervals may not intersect if the clocks drift, fall back to the tightest sample
+		if (low <= high) {
+			dev->clockOffset	= low + (high - low) / 2;
+			dev->clockDeviation	= (uint64_t)(high - low) / 2;
+		} else {
+			dev->clockOffset	= bestOffset;
+			dev->clockDeviation	= (uint64_t)bestWidth / 2;
+		}
+	}
+	vkDestroyQueryPool (vkDev, query, NULL);
+	vkDestroyFence (vkDev, fence, NULL);
+	vkFreeCommandBuffers (vkDev, pool, 1, &cmd);
+	vkDestroyCommandPool (vkDev, pool, NULL);
+	return result;
+}
+/**
+ * @brief compute the offset between device timestamps and vkh_host_time with VK_EXT_calibrated_timestamps
+ * if enabled, else by timing a timestamp written on 'queue' (may be NULL to only try the extension).
+ * Clocks drift, calibration should be repeated from time to time for long sessions.
+ * @return true if the device is calibrated.
+ */
+bool vkh_device_calibrate_timestamps (VkhDevice dev, VkhQueue queue) {
+#ifdef VK_EXT_calibrated_timestamps
+	if (_calibrate_ext (dev)) {
+		dev->calibrated = true;
+		return true;
+	}
+#endif
+	if (queue != NULL && _calibrate_fence (dev, queue))
+		dev->calibrated = true;
+	return dev->calibrated;
+}
+bool vkh_device_is_calibrated (VkhDevice dev) {
+	return dev->calibrated;
+}
+//maximum error of the calibration in nanoseconds.
+uint64_t vkh_device_get_calibration_deviation (VkhDevice dev) {
+	return dev->clockDeviation;
+}
+//convert a timestamp query result to vkh_host_time nanoseconds, device has to be calibrated.
+uint64_t vkh_device_gpu_to_host_time (VkhDevice dev, uint64_t ticks) {
+	return (uint64_t)((int64_t)((double)ticks * dev->timestampPeriod) + dev->clockOffset);
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vkh_cmd_allocator.h"
+#include "vkh_device.h"
+
+VkhCmdAllocator vkh_cmd_allocator_create (VkhDevice dev, uint32_t qFamIndex, uint32_t frameCount) {
+	VkhCmdAllocator ca = (VkhCmdAllocator)calloc(1, sizeof(vkh_cmd_allocator_t));
+	if (tss_create (&ca->threadKey, NULL) != thrd_success) {
+		fprintf (stderr, "vkh_cmd_allocator_create: tss_create failed\n");
+		free (ca);
+		return NULL;
+	}
+	ca->pDev		= dev;
+	ca->qFamIndex	= qFamIndex;
+	ca->frameCount	= frameCount;
+	ca->fences		= (VkFence*)malloc(frameCount * sizeof(VkFence));
+	ca->fencePending= (bool*)calloc(frameCount, sizeof(bool));
+	//unsignaled, a slot whose fence was never handed out is not waited
+	for (uint32_t i=0; i<frameCount; i++)
+		ca->fences[i] = vkh_fence_create (dev);
+	mtx_init (&ca->mutex, mtx_plain);
+	return ca;
+}
+void vkh_cmd_allocator_destroy (VkhCmdAllocator ca) {
+	if (ca == NULL)
+		return;
+	VkDevice dev = ca->pDev->dev;
+	vkh_cmd_thread_t* t = ca->threads;
+	while (t) {
+		vkh_cmd_thread_t* next = t->next;
+		for (uint32_t i=0; i<ca->frameCount; i++) {
+			vkDestroyCommandPool (dev, t->slots[i].pool, NULL);
+			free (t->slots[i].lists[0].cmds);
+			free (t->slots[i].lists[1].cmds);
+		}
+		free (t->slots);
+		free (t);
+		t = next;
+	}
+	for (uint32_t i=0; i<ca->frameCount; i++)
+		vkDestroyFence (dev, ca->fences[i], NULL);
+	free (ca->fences);
+	free (ca->fencePending);
+	tss_delete (ca->threadKey);
+	mtx_destroy (&ca->mutex);
+	free (ca);
+}
+static vkh_cmd_thread_t* _get_thread (VkhCmdAllocator ca) {
+	vkh_cmd_thread_t* t = (vkh_cmd_thread_t*)tss_get (ca->threadKey);
+	if (t)
+		return t;
+	t = (vkh_cmd_thread_t*)calloc(1, sizeof(vkh_cmd_thread_t));
+	t->slots = (vkh_cmd_slot_t*)calloc(ca->frameCount, sizeof(vkh_cmd_slot_t));
+	for (uint32_t i=0; i<ca->frameCount; i++)
+		t->slots[i].pool = vkh_cmd_pool_create (ca->pDev, ca->qFamIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+	mtx_lock (&ca->mutex);
+	t->next = ca->threads;
+	ca->threads = t;
+	mtx_unlock (&ca->mutex);
+	tss_set (ca->threadKey, t);
+	return t;
+}
+/**
+ * @brief get a command buffer from the calling thread pool of the current frame slot, no lock is taken
+ * once the thread has been seen. Command buffer is valid until the slot is reset by @ref vkh_cmd_allocator_next_frame.
+ */
+VkCommandBuffer vkh_cmd_allocator_get (VkhCmdAllocator ca, VkCommandBufferLevel level) {
+	vkh_cmd_slot_t* slot = &_get_thread (ca)->slots[ca->frame];
+	vkh_cmd_list_t* list = &slot->lists[level];
+	if (list->used == list->count) {
+		list->cmds = (VkCommandBuffer*)realloc(list->cmds, (list->count + VKH_CMD_ALLOC_CHUNK) * sizeof(VkCommandBuffer));
+		vkh_cmd_buffs_create (ca->pDev, slot->pool, level, VKH_CMD_ALLOC_CHUNK, &list->cmds[list->count]);
+		list->count += VKH_CMD_ALLOC_CHUNK;
+	}
+	return list->cmds[list->used++];
+}
+//unsignaled fence to submit with the last commands of the current frame slot, it is waited on the slot reuse.
+VkFence vkh_cmd_allocator_get_fence (VkhCmdAllocator ca) {
+	ca->fencePending[ca->frame] = true;
+	return ca->fences[ca->frame];
+}
+uint32_t vkh_cmd_allocator_get_frame (VkhCmdAllocator ca) {
+	return ca->frame;
+}
+/**
+ * @brief move to the next frame slot: wait for its fence, then reset the pools of every thread for this slot
+ * with a single vkResetCommandPool each. Must not be called while other threads are recording.
+ */
+void vkh_cmd_allocator_next_frame (VkhCmdAllocator ca) {
+	VkDevice dev = ca->pDev->dev;
+	ca->frame = (ca->frame + 1) % ca->frameCount;
+	if (ca->fencePending[ca->frame]) {
+		VkFence fence = ca->fences[ca->frame];
+		VK_CHECK_RESULT(vkWaitForFences (dev, 1, &fence, VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences (dev, 1, &fence));
+		ca->fencePending[ca->frame] = false;
+	}
+
+	mtx_lock (&ca->mutex);
+	for (vkh_cmd_thread_t* t = ca->threads; t; t = t->next) {
+		vkh_cmd_slot_t* slot = &t->slots[ca->frame];
+		if (slot->lists[0].used + slot->lists[1].used == 0)
+			continue;
+		VK_CHECK_RESULT(vkResetCommandPool (dev, slot->pool, 0));
+		slot->lists[0].used = slot->lists[1].used = 0;
+	}
+	mtx_unlock (&ca->mutex);
+}
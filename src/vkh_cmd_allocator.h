@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef VKH_CMD_ALLOCATOR_H
+#define VKH_CMD_ALLOCATOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "vkh.h"
+#include "deps/tinycthread.h"
+
+#define VKH_CMD_ALLOC_CHUNK	8	//command buffers allocated at once when a slot has no free one
+
+//command buffers of one level allocated from a slot pool, the first 'used' are in use for the current frame.
+typedef struct {
+	VkCommandBuffer*		cmds;
+	uint32_t				count;
+	uint32_t				used;
+}vkh_cmd_list_t;
+
+//pool of a recording thread for a frame slot
+typedef struct {
+	VkCommandPool			pool;
+	vkh_cmd_list_t			lists[2];//indexed by VkCommandBufferLevel
+}vkh_cmd_slot_t;
+
+typedef struct _vkh_cmd_thread_t {
+	struct _vkh_cmd_thread_t*	next;
+	vkh_cmd_slot_t*				slots;//one per frame slot
+}vkh_cmd_thread_t;
+
+typedef struct _vkh_cmd_allocator_t {
+	VkhDevice				pDev;
+	uint32_t				qFamIndex;
+	uint32_t				frameCount;
+	uint32_t				frame;//current frame slot
+	VkFence*				fences;//one per frame slot, signaled when slot commands are done
+	bool*					fencePending;//slot fence handed out for submission and not waited yet
+	tss_t					threadKey;//current thread vkh_cmd_thread_t
+	mtx_t					mutex;//protect the thread list, only locked on the first use by a thread
+	vkh_cmd_thread_t*		threads;
+}vkh_cmd_allocator_t;
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vkh_completion.h"
+#include "vkh_device.h"
+
+static bool _push_event (VkhCompletion cs, const vkh_watch_t* w, VkResult result) {
+	unsigned head = vkh_atomic_load_explicit (&cs->eventHead, vkh_memory_order_relaxed);
+	unsigned tail = vkh_atomic_load_explicit (&cs->eventTail, vkh_memory_order_acquire);
+	if (head - tail == cs->eventCapacity)
+		return false;
+	cs->events[head & (cs->eventCapacity - 1)] = (VkhCompletionEvent) {
+		.userData	= w->userData,
+		.timeline	= w->timeline,
+		.value		= w->value,
+		.fence		= w->fence,
+		.result		= result
+	};
+	vkh_atomic_store_explicit (&cs->eventHead, head + 1, vkh_memory_order_release);
+	return true;
+}
+//run the callback or queue the event, false if the event queue is full.
+static bool _dispatch (VkhCompletion cs, const vkh_watch_t* w, VkResult result) {
+	if (w->func)
+		w->func (w->userData, result);
+	else if (!_push_event (cs, w, result))
+		return false;
+	vkh_atomic_fetch_sub_explicit (&cs->pending, 1, vkh_memory_order_release);
+	return true;
+}
+//move registered watches to the dispatcher list, mutex must be locked.
+static void _merge_added (VkhCompletion cs) {
+	if (cs->watchCount + cs->addedCount > cs->watchReserved) {
+		while (cs->watchCount + cs->addedCount > cs->watchReserved)
+			cs->watchReserved *= 2;
+		cs->watches = (vkh_watch_t*)realloc(cs->watches, cs->watchReserved * sizeof(vkh_watch_t));
+		cs->waitSemaphores	= (VkSemaphore*)realloc(cs->waitSemaphores, (cs->watchReserved + 1) * sizeof(VkSemaphore));
+		cs->waitValues		= (uint64_t*)realloc(cs->waitValues, (cs->watchReserved + 1) * sizeof(uint64_t));
+		cs->waitFences		= (VkFence*)realloc(cs->waitFences, cs->watchReserved * sizeof(VkFence));
+	}
+	memcpy (&cs->watches[cs->watchCount], cs->added, cs->addedCount * sizeof(vkh_watch_t));
+	cs->watchCount += cs->addedCount;
+	cs->addedCount = 0;
+}
+/**
+ * @brief block until a watched timeline reaches its value, the wake timeline is signaled or the slice ends.
+ * @return VK_TIMEOUT if nothing needs to be scanned.
+ */
+static VkResult _wait (VkhCompletion cs, uint64_t wakeValue) {
+	VkDevice dev = cs->dev->dev;
+	uint32_t semCount = 0, fenceCount = 0;
+	cs->waitSemaphores[semCount] = cs->wake;
+	cs->waitValues[semCount++] = wakeValue + 1;
+	for (uint32_t i=0; i<cs->watchCount; i++) {
+		vkh_watch_t* w = &cs->watches[i];
+		if (w->timeline) {
+			cs->waitSemaphores[semCount] = w->timeline;
+			cs->waitValues[semCount++] = w->value;
+		} else
+			cs->waitFences[fenceCount++] = w->fence;
+	}
+	uint64_t timeout = fenceCount > 0 ? VKH_COMPLETION_SLICE_NS : UINT64_MAX;
+	if (fenceCount > 0 && semCount == 1)
+		return vkWaitForFences (dev, fenceCount, cs->waitFences, VK_FALSE, timeout);
+	VkSemaphoreWaitInfo waitInfo = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+									 .flags = VK_SEMAPHORE_WAIT_ANY_BIT,
+									 .semaphoreCount = semCount,
+									 .pSemaphores = cs->waitSemaphores,
+									 .pValues = cs->waitValues };
+	VkResult res = vkWaitSemaphores (dev, &waitInfo, timeout);
+	//fences are not part of the semaphore wait, they are polled at the end of every slice
+	return res == VK_TIMEOUT && fenceCount > 0 ? VK_SUCCESS : res;
+}
+//dispatch completed watches keeping registration order, return false if the event queue filled up.
+static bool _scan (VkhCompletion cs, VkResult waitResult) {
+	VkDevice dev = cs->dev->dev;
+	bool stalled = false;
+	uint32_t kept = 0;
+	for (uint32_t i=0; i<cs->watchCount; i++) {
+		vkh_watch_t* w = &cs->watches[i];
+		VkResult result = VK_NOT_READY;
+		if (waitResult < 0)
+			result = waitResult;//device lost, complete everything with the error
+		else if (w->timeline) {
+			uint64_t value = 0;
+			result = vkGetSemaphoreCounterValue (dev, w->timeline, &value);
+			if (result == VK_SUCCESS && value < w->value)
+				result = VK_NOT_READY;
+		} else
+			result = vkGetFenceStatus (dev, w->fence);
+		if (result == VK_NOT_READY || stalled || !_dispatch (cs, w, result)) {
+			stalled |= result != VK_NOT_READY;
+			cs->watches[kept++] = *w;
+		}
+	}
+	cs->watchCount = kept;
+	return !stalled;
+}
+static int _dispatcher_main (void* arg) {
+	VkhCompletion cs = (VkhCompletion)arg;
+	bool stalled = false;
+	while (true) {
+		mtx_lock (&cs->mutex);
+		cs->waiting = false;
+		while (!cs->quit && cs->addedCount == 0 && cs->watchCount == 0)
+			cnd_wait (&cs->wakeup, &cs->mutex);
+		if (cs->quit) {
+			mtx_unlock (&cs->mutex);
+			break;
+		}
+		_merge_added (cs);
+		uint64_t wakeValue = cs->wakeValue;
+		cs->waiting = !stalled;
+		mtx_unlock (&cs->mutex);
+
+		VkResult res = VK_SUCCESS;
+		if (stalled) {
+			//event queue full, give the consumer a slice to poll
+			struct timespec slice = { .tv_sec = 0, .tv_nsec = VKH_COMPLETION_SLICE_NS };
+			thrd_sleep (&slice, NULL);
+		} else
+			res = _wait (cs, wakeValue);
+		if (res != VK_TIMEOUT)
+			stalled = !_scan (cs, res);
+	}
+	return 0;
+}
+
+/**
+ * @brief start the completion dispatcher thread of 'dev', requires the timelineSemaphore feature.
+ * @param eventCapacity size of the event queue read with vkh_completion_poll, rounded up to a power of two.
+ */
+VkhCompletion vkh_completion_create (VkhDevice dev, uint32_t eventCapacity) {
+	VkhCompletion cs = (VkhCompletion)calloc(1, sizeof(vkh_completion_t));
+	cs->dev = dev;
+	cs->wake = vkh_timeline_create (dev, 0);
+	cs->addedReserved = cs->watchReserved = VKH_COMPLETION_INIT_SIZE;
+	cs->added			= (vkh_watch_t*)malloc(cs->addedReserved * sizeof(vkh_watch_t));
+	cs->watches			= (vkh_watch_t*)malloc(cs->watchReserved * sizeof(vkh_watch_t));
+	cs->waitSemaphores	= (VkSemaphore*)malloc((cs->watchReserved + 1) * sizeof(VkSemaphore));
+	cs->waitValues		= (uint64_t*)malloc((cs->watchReserved + 1) * sizeof(uint64_t));
+	cs->waitFences		= (VkFence*)malloc(cs->watchReserved * sizeof(VkFence));
+	cs->eventCapacity = 1;
+	while (cs->eventCapacity < eventCapacity)
+		cs->eventCapacity *= 2;
+	cs->events = (VkhCompletionEvent*)malloc(cs->eventCapacity * sizeof(VkhCompletionEvent));
+	mtx_init (&cs->mutex, mtx_plain);
+	cnd_init (&cs->wakeup);
+	thrd_create (&cs->thread, _dispatcher_main, cs);
+	return cs;
+}
+//stop the dispatcher, watches still pending are dropped without being dispatched.
+void vkh_completion_destroy (VkhCompletion cs) {
+	if (cs == NULL)
+		return;
+	mtx_lock (&cs->mutex);
+	cs->quit = true;
+	if (cs->waiting) {
+		VkSemaphoreSignalInfo signalInfo = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+											 .semaphore = cs->wake, .value = ++cs->wakeValue };
+		VK_CHECK_RESULT(vkSignalSemaphore (cs->dev->dev, &signalInfo));
+	}
+	cnd_signal (&cs->wakeup);
+	mtx_unlock (&cs->mutex);
+	thrd_join (cs->thread, NULL);
+
+	vkDestroySemaphore (cs->dev->dev, cs->wake, NULL);
+	cnd_destroy (&cs->wakeup);
+	mtx_destroy (&cs->mutex);
+	free (cs->added);
+	free (cs->watches);
+	free (cs->waitSemaphores);
+	free (cs->waitValues);
+	free (cs->waitFences);
+	free (cs->events);
+	free (cs);
+}
+static void _watch (VkhCompletion cs, const vkh_watch_t* w) {
+	vkh_atomic_fetch_add_explicit (&cs->pending, 1, vkh_memory_order_relaxed);
+	mtx_lock (&cs->mutex);
+	if (cs->addedCount == cs->addedReserved) {
+		cs->addedReserved *= 2;
+		cs->added = (vkh_watch_t*)realloc(cs->added, cs->addedReserved * sizeof(vkh_watch_t));
+	}
+	cs->added[cs->addedCount++] = *w;
+	//interrupt the device wait only once until the dispatcher picks up the new watches
+	if (cs->waiting) {
+		cs->waiting = false;
+		VkSemaphoreSignalInfo signalInfo = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+											 .semaphore = cs->wake, .value = ++cs->wakeValue };
+		VK_CHECK_RESULT(vkSignalSemaphore (cs->dev->dev, &signalInfo));
+	}
+	cnd_signal (&cs->wakeup);
+	mtx_unlock (&cs->mutex);
+}
+/**
+ * @brief dispatch when 'timeline' reaches 'value'. Callable from any thread.
+ * @param func called on the dispatcher thread, keep it short. If null, an event is queued for vkh_completion_poll.
+ */
+void vkh_completion_watch_timeline (VkhCompletion cs, VkSemaphore timeline, uint64_t value, VkhCompletionFunc func, void* userData) {
+	vkh_watch_t w = { .timeline = timeline, .value = value, .func = func, .userData = userData };
+	_watch (cs, &w);
+}
+/**
+ * @brief dispatch when 'fence' is signaled, fences are polled every VKH_COMPLETION_SLICE_NS.
+ * The fence must not be reset before being dispatched.
+ */
+void vkh_completion_watch_fence (VkhCompletion cs, VkFence fence, VkhCompletionFunc func, void* userData) {
+	vkh_watch_t w = { .fence = fence, .func = func, .userData = userData };
+	_watch (cs, &w);
+}
+/**
+ * @brief pop the oldest completion event without blocking, a single thread may poll.
+ * @return false if no event is queued.
+ */
+bool vkh_completion_poll (VkhCompletion cs, VkhCompletionEvent* pEvent) {
+	unsigned tail = vkh_atomic_load_explicit (&cs->eventTail, vkh_memory_order_relaxed);
+	unsigned head = vkh_atomic_load_explicit (&cs->eventHead, vkh_memory_order_acquire);
+	if (tail == head)
+		return false;
+	*pEvent = cs->events[tail & (cs->eventCapacity - 1)];
+	vkh_atomic_store_explicit (&cs->eventTail, tail + 1, vkh_memory_order_release);
+	return true;
+}
+//watches registered and not yet dispatched.
+uint32_t vkh_completion_get_pending (VkhCompletion cs) {
+	return vkh_atomic_load_explicit (&cs->pending, vkh_memory_order_acquire);
+}
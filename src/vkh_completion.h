@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef VKH_COMPLETION_H
+#define VKH_COMPLETION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "vkh.h"
+#include "deps/tinycthread.h"
+#include "vkh_atomic.h"
+
+#define VKH_COMPLETION_INIT_SIZE	16
+#define VKH_COMPLETION_SLICE_NS		1000000	//fences polling period, fences can't be waited with semaphores
+
+typedef struct {
+	VkSemaphore				timeline;//null for fence watches
+	uint64_t				value;
+	VkFence					fence;
+	VkhCompletionFunc		func;//null to push an event
+	void*					userData;
+}vkh_watch_t;
+
+typedef struct _vkh_completion_t {
+	VkhDevice				dev;
+	thrd_t					thread;
+	mtx_t					mutex;//protect added watches, quit and wake signaling
+	cnd_t					wakeup;//dispatcher sleeps on it when nothing is watched
+	bool					quit;
+	bool					waiting;//dispatcher is blocked in a device wait, wake it with the wake timeline
+	VkSemaphore				wake;//host signaled timeline included in every semaphore wait
+	uint64_t				wakeValue;
+	vkh_watch_t*			added;//registered since the last dispatcher loop
+	uint32_t				addedCount;
+	uint32_t				addedReserved;
+	vkh_watch_t*			watches;//owned by the dispatcher thread
+	uint32_t				watchCount;
+	uint32_t				watchReserved;
+	VkSemaphore*			waitSemaphores;
+	uint64_t*				waitValues;
+	VkFence*				waitFences;
+	uint32_t				waitReserved;
+	vkh_atomic_uint			pending;//watches not yet dispatched
+	//single producer (dispatcher) single consumer (vkh_completion_poll) ring
+	VkhCompletionEvent*		events;
+	uint32_t				eventCapacity;//power of two
+	vkh_atomic_uint			eventHead;
+	vkh_atomic_uint			eventTail;
+}vkh_completion_t;
+
+#ifdef __cplusplus
+}
+#endif
+#endif
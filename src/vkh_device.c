@@ -22,6 +22,8 @@
 #include "vkh_device.h"
 #include "vkh_phyinfo.h"
 #include "vkh_app.h"
+#include "vkh_immediate.h"
+#include "vkh_profiler.h"
 #include "string.h"
 
 
@@ -46,6 +48,10 @@ VkhDevice vkh_device_import (VkInstance inst, VkPhysicalDevice phy, VkDevice vkD
 	dev->instance = inst;
 
 	vkGetPhysicalDeviceMemoryProperties (phy, &dev->phyMemProps);
+	vkGetPhysicalDeviceQueueFamilyProperties (phy, &dev->queueFamilyCount, NULL);
+	dev->immediates = (vkh_immediate_t**)calloc(dev->queueFamilyCount, sizeof(vkh_immediate_t*));
+	mtx_init (&dev->immediateMutex, mtx_plain);
+	vkh_fence_pool_init (dev);
 #ifdef VKH_USE_VMA
 	VmaAllocatorCreateInfo allocatorInfo = {
 		.physicalDevice = phy,
@@ -53,6 +59,29 @@ VkhDevice vkh_device_import (VkInstance inst, VkPhysicalDevice phy, VkDevice vkD
 	};
 	vmaCreateAllocator(&allocatorInfo, &dev->allocator);
 #else
+#endif
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties (phy, &props);
+	dev->timestampPeriod = props.limits.timestampPeriod;
+#ifdef VK_EXT_calibrated_timestamps
+	dev->GetCalibratedTimestampsEXT = (PFN_vkGetCalibratedTimestampsEXT)vkGetDeviceProcAddr(vkDev, "vkGetCalibratedTimestampsEXT");
+#endif
+#ifdef VK_EXT_host_image_copy
+	dev->CopyMemoryToImageEXT		= (PFN_vkCopyMemoryToImageEXT)		vkGetDeviceProcAddr(vkDev, "vkCopyMemoryToImageEXT");
+	dev->CopyImageToMemoryEXT		= (PFN_vkCopyImageToMemoryEXT)		vkGetDeviceProcAddr(vkDev, "vkCopyImageToMemoryEXT");
+	dev->TransitionImageLayoutEXT	= (PFN_vkTransitionImageLayoutEXT)	vkGetDeviceProcAddr(vkDev, "vkTransitionImageLayoutEXT");
+	if (vkh_device_host_image_copy_supported (dev)) {
+		VkPhysicalDeviceHostImageCopyPropertiesEXT hostCopyProps = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT };
+		VkPhysicalDeviceProperties2 props2 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &hostCopyProps };
+		vkGetPhysicalDeviceProperties2 (phy, &props2);
+		dev->hostCopySrcLayouts = hostCopyProps.pCopySrcLayouts =
+				(VkImageLayout*)malloc((hostCopyProps.copySrcLayoutCount + 1) * sizeof(VkImageLayout));
+		dev->hostCopyDstLayouts = hostCopyProps.pCopyDstLayouts =
+				(VkImageLayout*)malloc((hostCopyProps.copyDstLayoutCount + 1) * sizeof(VkImageLayout));
+		vkGetPhysicalDeviceProperties2 (phy, &props2);
+		dev->hostCopySrcLayoutCount = hostCopyProps.copySrcLayoutCount;
+		dev->hostCopyDstLayoutCount = hostCopyProps.copyDstLayoutCount;
+	}
 #endif
 
 	return dev;
@@ -66,6 +95,67 @@ VkPhysicalDevice vkh_device_get_phy (VkhDevice dev) {
 VkhApp vkh_device_get_app (VkhDevice dev) {
 	return dev->vkhApplication;
 }
+/**
+ * @brief set a hook called when the last reference of a VkhImage or a VkhBuffer is released,
+ * before destruction, for ex. to feed a resource recycler.
+ * @param hook if it returns true, object is kept alive with a single reference owned by the hook.
+ */
+void vkh_device_set_release_hook (VkhDevice dev, VkhReleaseHook hook, void* userData) {
+	dev->releaseHookUserData = userData;
+	dev->releaseHook = hook;
+}
+bool vkh_device_release_hook (VkhDevice dev, VkObjectType objectType, void* object) {
+	if (dev->releaseHook == NULL)
+		return false;
+	return dev->releaseHook (dev->releaseHookUserData, objectType, object);
+}
+//true if VK_EXT_host_image_copy has been enabled for this device.
+bool vkh_device_host_image_copy_supported (VkhDevice dev) {
+#ifdef VK_EXT_host_image_copy
+	return dev->CopyMemoryToImageEXT && dev->CopyImageToMemoryEXT && dev->TransitionImageLayoutEXT;
+#else
+	return false;
+#endif
+}
+//true if 'layout' is in the host image copy destination layouts if 'dst' is true, or in the source layouts.
+bool vkh_device_host_copy_layout_supported (VkhDevice dev, VkImageLayout layout, bool dst) {
+#ifdef VK_EXT_host_image_copy
+	const VkImageLayout* layouts = dst ? dev->hostCopyDstLayouts : dev->hostCopySrcLayouts;
+	uint32_t count = dst ? dev->hostCopyDstLayoutCount : dev->hostCopySrcLayoutCount;
+	for (uint32_t i=0; i<count; i++) {
+		if (layouts[i] == layout)
+			return true;
+	}
+#endif
+	return false;
+}
+/**
+ * @brief declare the presentId and presentWait features enabled on the device, with VK_KHR_present_id and
+ * VK_KHR_present_wait. Presenters then attach present ids and pace on present completion.
+ */
+void vkh_device_enable_present_wait (VkhDevice dev) {
+#ifdef VK_KHR_present_wait
+	dev->WaitForPresentKHR = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(dev->dev, "vkWaitForPresentKHR");
+#endif
+}
+/**
+ * @brief declare the synchronization2 feature enabled on the device, either core 1.3 or VK_KHR_synchronization2.
+ * Split barriers then use vkCmdSetEvent2 and vkCmdWaitEvents2.
+ */
+void vkh_device_enable_synchronization2 (VkhDevice dev) {
+#ifdef VK_VERSION_1_3
+	dev->CmdSetEvent2	= (PFN_vkCmdSetEvent2)	vkGetDeviceProcAddr(dev->dev, "vkCmdSetEvent2");
+	dev->CmdWaitEvents2	= (PFN_vkCmdWaitEvents2)vkGetDeviceProcAddr(dev->dev, "vkCmdWaitEvents2");
+	dev->CmdResetEvent2	= (PFN_vkCmdResetEvent2)vkGetDeviceProcAddr(dev->dev, "vkCmdResetEvent2");
+	if (!dev->CmdSetEvent2 || !dev->CmdWaitEvents2 || !dev->CmdResetEvent2) {
+		dev->CmdSetEvent2	= (PFN_vkCmdSetEvent2)	vkGetDeviceProcAddr(dev->dev, "vkCmdSetEvent2KHR");
+		dev->CmdWaitEvents2	= (PFN_vkCmdWaitEvents2)vkGetDeviceProcAddr(dev->dev, "vkCmdWaitEvents2KHR");
+		dev->CmdResetEvent2	= (PFN_vkCmdResetEvent2)vkGetDeviceProcAddr(dev->dev, "vkCmdResetEvent2KHR");
+	}
+	if (!dev->CmdSetEvent2 || !dev->CmdWaitEvents2 || !dev->CmdResetEvent2)
+		dev->CmdSetEvent2 = NULL;
+#endif
+}
 /**
  * @brief get instance proc addresses for debug utils (name, label,...)
  * @param vkh device
@@ -96,6 +186,13 @@ void vkh_device_destroy_sampler (VkhDevice dev, VkSampler sampler) {
 	vkDestroySampler (dev->dev, sampler, NULL);
 }
 void vkh_device_destroy (VkhDevice dev) {
+	vkh_immediate_release (dev);
+	mtx_destroy (&dev->immediateMutex);
+	vkh_fence_pool_release (dev);
+#ifdef VK_EXT_host_image_copy
+	free (dev->hostCopySrcLayouts);
+	free (dev->hostCopyDstLayouts);
+#endif
 #ifdef VKH_USE_VMA
 	vmaDestroyAllocator (dev->allocator);
 #else
@@ -121,7 +218,8 @@ void vkh_cmd_label_start (VkCommandBuffer cmd, const char* name, const float col
 		.pLabelName= name
 	};
 	memcpy ((void*)info.color, (void*)color, 4 * sizeof(float));
-	CmdBeginDebugUtilsLabelEXT (cmd, &info);
+	if (CmdBeginDebugUtilsLabelEXT)
+		CmdBeginDebugUtilsLabelEXT (cmd, &info);
 }
 void vkh_cmd_label_insert (VkCommandBuffer cmd, const char* name, const float color[4]) {
 	const VkDebugUtilsLabelEXT info = {
@@ -130,8 +228,23 @@ void vkh_cmd_label_insert (VkCommandBuffer cmd, const char* name, const float co
 		.pLabelName= name
 	};
 	memcpy ((void*)info.color, (void*)color, 4 * sizeof(float));
-	CmdInsertDebugUtilsLabelEXT (cmd, &info);
+	if (CmdInsertDebugUtilsLabelEXT)
+		CmdInsertDebugUtilsLabelEXT (cmd, &info);
 }
 void vkh_cmd_label_end (VkCommandBuffer cmd) {
-	CmdEndDebugUtilsLabelEXT (cmd);
+	if (CmdEndDebugUtilsLabelEXT)
+		CmdEndDebugUtilsLabelEXT (cmd);
+}
+//debug label also timed by the profiler attached to 'dev', if any.
+void vkh_device_cmd_label_start (VkhDevice dev, VkCommandBuffer cmd, const char* name, const float color[4]) {
+	vkh_cmd_label_start (cmd, name, color);
+	VkhProfiler prof = vkh_atomic_ptr_load_explicit (&dev->profiler, vkh_memory_order_acquire);
+	if (prof)
+		vkh_profiler_label_start (prof, cmd, name);
+}
+void vkh_device_cmd_label_end (VkhDevice dev, VkCommandBuffer cmd) {
+	VkhProfiler prof = vkh_atomic_ptr_load_explicit (&dev->profiler, vkh_memory_order_acquire);
+	if (prof)
+		vkh_profiler_label_end (prof, cmd);
+	vkh_cmd_label_end (cmd);
 }
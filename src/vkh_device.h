@@ -27,6 +27,9 @@ extern "C" {
 #endif
 
 #include "vkh.h"
+#include "deps/tinycthread.h"
+#include "vkh_atomic.h"
+#include "vkh_fence_pool.h"
 
 #ifdef VKH_USE_VMA
 #include "vk_mem_alloc.h"
@@ -41,8 +44,47 @@ typedef struct _vkh_device_t{
 	VmaAllocator			allocator;
 #endif
 	VkhApp					vkhApplication;
+	VkhReleaseHook			releaseHook;
+	void*					releaseHookUserData;
+	uint32_t				queueFamilyCount;
+	struct _vkh_immediate_t**	immediates;//one-shot submission contexts per queue family, created on first use
+	mtx_t					immediateMutex;
+	vkh_atomic_ptr(VkhProfiler)	profiler;//fed by vkh_device_cmd_label_start/end
+	vkh_fence_pool_t		fencePool;
+	double					timestampPeriod;//nanoseconds per timestamp tick
+	int64_t					clockOffset;//vkh_host_time minus device time in nanoseconds
+	uint64_t				clockDeviation;
+	bool					calibrated;
+#ifdef VK_EXT_calibrated_timestamps
+	PFN_vkGetCalibratedTimestampsEXT	GetCalibratedTimestampsEXT;//null if extension is not enabled on device.
+#endif
+#ifdef VK_KHR_present_wait
+	PFN_vkWaitForPresentKHR			WaitForPresentKHR;//null until vkh_device_enable_present_wait, presentId is enabled too.
+#endif
+#ifdef VK_VERSION_1_3
+	//synchronization2 entry points used by split barriers, null until vkh_device_enable_synchronization2.
+	PFN_vkCmdSetEvent2				CmdSetEvent2;
+	PFN_vkCmdWaitEvents2			CmdWaitEvents2;
+	PFN_vkCmdResetEvent2			CmdResetEvent2;
+#endif
+#ifdef VK_EXT_host_image_copy
+	//VK_EXT_host_image_copy entry points, null if extension is not enabled on device.
+	PFN_vkCopyMemoryToImageEXT		CopyMemoryToImageEXT;
+	PFN_vkCopyImageToMemoryEXT		CopyImageToMemoryEXT;
+	PFN_vkTransitionImageLayoutEXT	TransitionImageLayoutEXT;
+	VkImageLayout*					hostCopySrcLayouts;//layouts supported as host copy source and transition old layout
+	uint32_t						hostCopySrcLayoutCount;
+	VkImageLayout*					hostCopyDstLayouts;//layouts supported as host copy destination and transition new layout
+	uint32_t						hostCopyDstLayoutCount;
+#endif
 }vkh_device_t;
 
+bool vkh_device_release_hook (VkhDevice dev, VkObjectType objectType, void* object);
+bool vkh_device_host_copy_layout_supported (VkhDevice dev, VkImageLayout layout, bool dst);
+void vkh_cmd_split_barrier (VkhDevice dev, VkCommandBuffer cmd, VkEvent evt, bool wait,
+							VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages,
+							const VkBufferMemoryBarrier* buffBarrier, const VkImageMemoryBarrier* imgBarrier);
+
 #ifdef __cplusplus
 }
 #endif
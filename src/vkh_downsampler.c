@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vkh_downsampler.h"
+#include "vkh_device.h"
+#include "vkh_image.h"
+#include "vkh_buffer.h"
+#include "vkh_stats.h"
+
+#ifndef MIN
+# define MIN(a,b) (((a) < (b)) ? (a) : (b))
+#endif
+
+#ifdef VKH_ENABLE_DOWNSAMPLER
+static const uint32_t downsample_spv[] =
+#include "downsample.comp.inc"
+;
+#endif
+
+typedef struct {
+	uint32_t mips;
+	uint32_t groupCount;
+	uint32_t midWidth;
+	uint32_t filterMode;
+}vkh_downsample_push_t;
+
+//upper limit of VkPhysicalDeviceLimits::minStorageBufferOffsetAlignment
+#define SCRATCH_MID_ALIGNMENT 256
+
+VkhDownsampler vkh_downsampler_create (VkhDevice dev, uint32_t maxImages) {
+#ifndef VKH_ENABLE_DOWNSAMPLER
+	fprintf (stderr, "vkh built without compute downsampler (glslc not found).\n");
+	return NULL;
+#else
+	//mips are written through unformatted storage images.
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures (dev->phy, &features);
+	if (!features.shaderStorageImageWriteWithoutFormat) {
+		fprintf (stderr, "vkh downsampler: shaderStorageImageWriteWithoutFormat not supported.\n");
+		return NULL;
+	}
+	VkhDownsampler ds = (VkhDownsampler)calloc(1, sizeof(vkh_downsampler_t));
+	ds->pDev	= dev;
+	ds->maxJobs	= maxImages;
+	ds->jobs	= (vkh_downsample_job_t*)calloc(maxImages, sizeof(vkh_downsample_job_t));
+
+	VkShaderModuleCreateInfo moduleInfo = { .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+											.codeSize = sizeof(downsample_spv),
+											.pCode = downsample_spv };
+	VK_CHECK_RESULT(vkCreateShaderModule (dev->dev, &moduleInfo, NULL, &ds->shader));
+
+	VkDescriptorSetLayoutBinding bindings[] = {
+		{0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,	1,							VK_SHADER_STAGE_COMPUTE_BIT, NULL},
+		{1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,			VKH_DOWNSAMPLE_MAX_MIPS,	VK_SHADER_STAGE_COMPUTE_BIT, NULL},
+		{2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			1,							VK_SHADER_STAGE_COMPUTE_BIT, NULL},
+		{3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			1,							VK_SHADER_STAGE_COMPUTE_BIT, NULL}
+	};
+	VkDescriptorSetLayoutCreateInfo dsLayoutInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+													 .bindingCount = 4,
+													 .pBindings = bindings };
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout (dev->dev, &dsLayoutInfo, NULL, &ds->dsLayout));
+
+	VkPushConstantRange pushRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(vkh_downsample_push_t) };
+	VkPipelineLayoutCreateInfo layoutInfo = { .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+											  .setLayoutCount = 1,
+											  .pSetLayouts = &ds->dsLayout,
+											  .pushConstantRangeCount = 1,
+											  .pPushConstantRanges = &pushRange };
+	VK_CHECK_RESULT(vkCreatePipelineLayout (dev->dev, &layoutInfo, NULL, &ds->layout));
+
+	VkComputePipelineCreateInfo pipelineInfo = { .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+												 .stage = { .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+															.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+															.module = ds->shader,
+															.pName = "main" },
+												 .layout = ds->layout };
+	VK_CHECK_RESULT(vkCreateComputePipelines (dev->dev, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &ds->pipeline));
+
+	//texels are fetched, not sampled, so format does not need linear filtering support.
+	ds->sampler = vkh_device_create_sampler (dev, VK_FILTER_NEAREST, VK_FILTER_NEAREST,
+											 VK_SAMPLER_MIPMAP_MODE_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+
+	VkDescriptorPoolSize poolSizes[] = {
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,	maxImages},
+		{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,			maxImages * VKH_DOWNSAMPLE_MAX_MIPS},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			maxImages * 2}
+	};
+	VkDescriptorPoolCreateInfo poolInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+											.maxSets = maxImages,
+											.poolSizeCount = 3,
+											.pPoolSizes = poolSizes };
+	VK_CHECK_RESULT(vkCreateDescriptorPool (dev->dev, &poolInfo, NULL, &ds->descriptorPool));
+
+	return ds;
+#endif
+}
+void vkh_downsampler_reset (VkhDownsampler ds) {
+	VkDevice dev = ds->pDev->dev;
+	for (uint32_t i=0; i<ds->jobCount; i++) {
+		vkh_downsample_job_t* job = &ds->jobs[i];
+		for (uint32_t v=0; v<job->viewCount; v++)
+			vkDestroyImageView (dev, job->views[v], NULL);
+		vkh_buffer_destroy_force (job->scratch);
+	}
+	memset (ds->jobs, 0, ds->jobCount * sizeof(vkh_downsample_job_t));
+	ds->jobCount = 0;
+	vkResetDescriptorPool (dev, ds->descriptorPool, 0);
+}
+void vkh_downsampler_destroy (VkhDownsampler ds) {
+	if (ds == NULL)
+		return;
+	VkDevice dev = ds->pDev->dev;
+	vkh_downsampler_reset (ds);
+	vkDestroyDescriptorPool (dev, ds->descriptorPool, NULL);
+	vkDestroySampler (dev, ds->sampler, NULL);
+	vkDestroyPipeline (dev, ds->pipeline, NULL);
+	vkDestroyPipelineLayout (dev, ds->layout, NULL);
+	vkDestroyDescriptorSetLayout (dev, ds->dsLayout, NULL);
+	vkDestroyShaderModule (dev, ds->shader, NULL);
+	free (ds->jobs);
+	free (ds);
+}
+static VkImageView _create_mip_view (VkhImage img, uint32_t level) {
+	VkImageView view;
+	VkImageViewCreateInfo viewInfo = { .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+									   .image = img->image,
+									   .viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+									   .format = img->infos.format,
+									   .components = {VK_COMPONENT_SWIZZLE_R,VK_COMPONENT_SWIZZLE_G,VK_COMPONENT_SWIZZLE_B,VK_COMPONENT_SWIZZLE_A},
+									   .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, img->infos.arrayLayers}};
+	VK_CHECK_RESULT(vkCreateImageView (img->pDev->dev, &viewInfo, NULL, &view));
+	return view;
+}
+/**
+ * @brief record the generation of the mip chain of 'img' from its level 0 in a single dispatch.
+ * Image must be a 2d image or array with storage and sampled usages, its format has to support storage
+ * writes without format qualifier. Up to 12 levels are generated, only 6 if image is larger than 4096 texels.
+ * Resources used by the recorded commands are kept until @ref vkh_downsampler_reset.
+ * @return false if image is not supported or if the downsampler is full.
+ */
+bool vkh_downsampler_cmd_generate (VkhDownsampler ds, VkCommandBuffer cmd, VkhImage img, VkhDownsampleFilter filter, VkImageLayout finalLayout) {
+	VkImageCreateInfo* pInfos = &img->infos;
+	if (ds->jobCount == ds->maxJobs || pInfos->imageType != VK_IMAGE_TYPE_2D || pInfos->mipLevels < 2 ||
+			(pInfos->usage & (VK_IMAGE_USAGE_STORAGE_BIT|VK_IMAGE_USAGE_SAMPLED_BIT)) != (VK_IMAGE_USAGE_STORAGE_BIT|VK_IMAGE_USAGE_SAMPLED_BIT))
+		return false;
+
+	VkDevice dev = ds->pDev->dev;
+	vkh_downsample_job_t* job = &ds->jobs[ds->jobCount++];
+
+	uint32_t mips = MIN(pInfos->mipLevels - 1, VKH_DOWNSAMPLE_MAX_MIPS);
+	uint32_t maxSize = VKH_DOWNSAMPLE_TILE_SIZE << 6;//one workgroup must be able to reduce mip 6 of the whole image
+	if (pInfos->extent.width > maxSize || pInfos->extent.height > maxSize)
+		mips = MIN(mips, 6);
+
+	vkh_downsample_push_t pc = {
+		.mips		= mips,
+		.midWidth	= (pInfos->extent.width + VKH_DOWNSAMPLE_TILE_SIZE - 1) / VKH_DOWNSAMPLE_TILE_SIZE,
+		.filterMode	= (uint32_t)filter
+	};
+	uint32_t groupsY = (pInfos->extent.height + VKH_DOWNSAMPLE_TILE_SIZE - 1) / VKH_DOWNSAMPLE_TILE_SIZE;
+	pc.groupCount = pc.midWidth * groupsY;
+
+	VkDeviceSize countersSize = pInfos->arrayLayers * sizeof(uint32_t);
+	VkDeviceSize midOffset = (countersSize + SCRATCH_MID_ALIGNMENT - 1) & ~(VkDeviceSize)(SCRATCH_MID_ALIGNMENT - 1);
+	VkDeviceSize midSize = (VkDeviceSize)pc.groupCount * pInfos->arrayLayers * 4 * sizeof(float);
+	job->scratch = vkh_buffer_create (ds->pDev, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+									  VKH_MEMORY_USAGE_GPU_ONLY, midOffset + midSize);
+
+	for (uint32_t l=0; l<=mips; l++)
+		job->views[l] = _create_mip_view (img, l);
+	job->viewCount = mips + 1;
+
+	VkDescriptorSet dSet;
+	VkDescriptorSetAllocateInfo allocInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+											  .descriptorPool = ds->descriptorPool,
+											  .descriptorSetCount = 1,
+											  .pSetLayouts = &ds->dsLayout };
+	VK_CHECK_RESULT(vkAllocateDescriptorSets (dev, &allocInfo, &dSet));
+
+	VkDescriptorImageInfo srcInfo = { ds->sampler, job->views[0], VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorImageInfo dstInfos[VKH_DOWNSAMPLE_MAX_MIPS];
+	for (uint32_t l=0; l<VKH_DOWNSAMPLE_MAX_MIPS; l++) {
+		//unused slots are filled with the last level, shader never writes to them.
+		VkDescriptorImageInfo dstInfo = { VK_NULL_HANDLE, job->views[MIN(l + 1, mips)], VK_IMAGE_LAYOUT_GENERAL };
+		dstInfos[l] = dstInfo;
+	}
+	VkDescriptorBufferInfo countersInfo	= { job->scratch->buffer, 0, countersSize };
+	VkDescriptorBufferInfo midInfo		= { job->scratch->buffer, midOffset, midSize };
+	VkWriteDescriptorSet writes[] = {
+		{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = dSet, .dstBinding = 0, .descriptorCount = 1,
+		  .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .pImageInfo = &srcInfo },
+		{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = dSet, .dstBinding = 1, .descriptorCount = VKH_DOWNSAMPLE_MAX_MIPS,
+		  .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .pImageInfo = dstInfos },
+		{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = dSet, .dstBinding = 2, .descriptorCount = 1,
+		  .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &countersInfo },
+		{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = dSet, .dstBinding = 3, .descriptorCount = 1,
+		  .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &midInfo }
+	};
+	vkUpdateDescriptorSets (dev, 4, writes, 0, NULL);
+
+	//counters are reset by the last workgroup of each slice, they only need to be cleared once.
+	vkCmdFillBuffer (cmd, job->scratch->buffer, 0, countersSize, 0);
+	VkBufferMemoryBarrier bufferBarrier = { .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+											.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+											.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+											.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+											.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+											.buffer = job->scratch->buffer,
+											.size = countersSize };
+	VkImageMemoryBarrier imageBarrier = { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+										  .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+										  .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+										  .oldLayout = img->layout,
+										  .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+										  .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+										  .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+										  .image = img->image,
+										  .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pInfos->mipLevels, 0, pInfos->arrayLayers}};
+	vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+						  0, NULL, 1, &bufferBarrier, 1, &imageBarrier);
+
+	vkCmdBindPipeline (cmd, VK_PIPELINE_BIND_POINT_COMPUTE, ds->pipeline);
+	vkCmdBindDescriptorSets (cmd, VK_PIPELINE_BIND_POINT_COMPUTE, ds->layout, 0, 1, &dSet, 0, NULL);
+	vkCmdPushConstants (cmd, ds->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(vkh_downsample_push_t), &pc);
+	vkCmdDispatch (cmd, pc.midWidth, groupsY, pInfos->arrayLayers);
+
+	imageBarrier.srcAccessMask	= VK_ACCESS_SHADER_WRITE_BIT;
+	imageBarrier.dstAccessMask	= VK_ACCESS_MEMORY_READ_BIT;
+	imageBarrier.oldLayout		= VK_IMAGE_LAYOUT_GENERAL;
+	imageBarrier.newLayout		= finalLayout;
+	vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+						  0, NULL, 0, NULL, 1, &imageBarrier);
+	VKH_STAT_ADD(VKH_STAT_BARRIERS, 2);
+	img->layout = finalLayout;
+	return true;
+}
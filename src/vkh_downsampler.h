@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef VKH_DOWNSAMPLER_H
+#define VKH_DOWNSAMPLER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "vkh.h"
+
+#define VKH_DOWNSAMPLE_MAX_MIPS		12
+#define VKH_DOWNSAMPLE_TILE_SIZE	64
+
+//resources of one recorded mip generation, released on reset
+typedef struct {
+	VkImageView				views[VKH_DOWNSAMPLE_MAX_MIPS + 1];//0 is the sampled view on mip 0
+	uint32_t				viewCount;
+	VkhBuffer				scratch;//atomic counters followed by mip 6 texels of each tile
+}vkh_downsample_job_t;
+
+typedef struct _vkh_downsampler_t {
+	VkhDevice				pDev;
+	VkShaderModule			shader;
+	VkDescriptorSetLayout	dsLayout;
+	VkPipelineLayout		layout;
+	VkPipeline				pipeline;
+	VkSampler				sampler;
+	VkDescriptorPool		descriptorPool;
+	uint32_t				maxJobs;
+	uint32_t				jobCount;
+	vkh_downsample_job_t*	jobs;
+}vkh_downsampler_t;
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vkh_fence_pool.h"
+#include "vkh_device.h"
+
+void vkh_fence_pool_init (VkhDevice dev) {
+	vkh_fence_pool_t* fp = &dev->fencePool;
+	mtx_init (&fp->mutex, mtx_plain);
+	fp->cleanReserved = fp->dirtyReserved = VKH_FENCE_POOL_INIT_SIZE;
+	fp->clean = (VkFence*)malloc(fp->cleanReserved * sizeof(VkFence));
+	fp->dirty = (VkFence*)malloc(fp->dirtyReserved * sizeof(VkFence));
+}
+//destroy pooled fences, acquired ones not released are owned by the caller.
+void vkh_fence_pool_release (VkhDevice dev) {
+	vkh_fence_pool_t* fp = &dev->fencePool;
+	for (uint32_t i=0; i<fp->cleanCount; i++)
+		vkDestroyFence (dev->dev, fp->clean[i], NULL);
+	for (uint32_t i=0; i<fp->dirtyCount; i++)
+		vkDestroyFence (dev->dev, fp->dirty[i], NULL);
+	free (fp->clean);
+	free (fp->dirty);
+	mtx_destroy (&fp->mutex);
+}
+/**
+ * @brief get an unsignaled fence from the device pool, a new one is created if none is free.
+ * Fences released since the last reset are all reset with a single vkResetFences first.
+ */
+VkFence vkh_fence_acquire (VkhDevice dev) {
+	vkh_fence_pool_t* fp = &dev->fencePool;
+	mtx_lock (&fp->mutex);
+	if (fp->cleanCount == 0 && fp->dirtyCount > 0) {
+		VK_CHECK_RESULT(vkResetFences (dev->dev, fp->dirtyCount, fp->dirty));
+		//swap lists, dirty ones are now clean
+		VkFence* tmp = fp->clean;
+		uint32_t reserved = fp->cleanReserved;
+		fp->clean			= fp->dirty;
+		fp->cleanReserved	= fp->dirtyReserved;
+		fp->cleanCount		= fp->dirtyCount;
+		fp->dirty			= tmp;
+		fp->dirtyReserved	= reserved;
+		fp->dirtyCount		= 0;
+	}
+	VkFence fence = fp->cleanCount > 0 ? fp->clean[--fp->cleanCount] : vkh_fence_create (dev);
+	mtx_unlock (&fp->mutex);
+	return fence;
+}
+/**
+ * @brief give back a fence to the device pool. It must not be used by a pending submission anymore,
+ * i.e. it is signaled or has never been submitted.
+ */
+void vkh_fence_release (VkhDevice dev, VkFence fence) {
+	vkh_fence_pool_t* fp = &dev->fencePool;
+	mtx_lock (&fp->mutex);
+	if (fp->dirtyCount == fp->dirtyReserved) {
+		fp->dirtyReserved *= 2;
+		fp->dirty = (VkFence*)realloc(fp->dirty, fp->dirtyReserved * sizeof(VkFence));
+	}
+	fp->dirty[fp->dirtyCount++] = fence;
+	mtx_unlock (&fp->mutex);
+}
+//non blocking completion check.
+bool vkh_fence_is_ready (VkhDevice dev, VkFence fence) {
+	return vkGetFenceStatus (dev->dev, fence) == VK_SUCCESS;
+}
+/**
+ * @brief wait for all the fences to be signaled.
+ * @param timeout in nanoseconds, 0 to poll.
+ * @return VK_SUCCESS, VK_TIMEOUT or an error.
+ */
+VkResult vkh_fences_wait_all (VkhDevice dev, uint32_t count, const VkFence* fences, uint64_t timeout) {
+	if (count == 0)
+		return VK_SUCCESS;
+	return vkWaitForFences (dev->dev, count, fences, VK_TRUE, timeout);
+}
+/**
+ * @brief wait for at least one fence to be signaled.
+ * @param pIndex if not NULL, receive the index of the first signaled fence in 'fences'.
+ * @return VK_SUCCESS, VK_TIMEOUT or an error.
+ */
+VkResult vkh_fences_wait_any (VkhDevice dev, uint32_t count, const VkFence* fences, uint64_t timeout, uint32_t* pIndex) {
+	if (count == 0)
+		return VK_TIMEOUT;
+	VkResult res = vkWaitForFences (dev->dev, count, fences, VK_FALSE, timeout);
+	if (res != VK_SUCCESS || pIndex == NULL)
+		return res;
+	for (uint32_t i=0; i<count; i++) {
+		if (vkGetFenceStatus (dev->dev, fences[i]) == VK_SUCCESS) {
+			*pIndex = i;
+			break;
+		}
+	}
+	return res;
+}
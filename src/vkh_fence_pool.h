@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef VKH_FENCE_POOL_H
+#define VKH_FENCE_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "vkh.h"
+#include "deps/tinycthread.h"
+
+#define VKH_FENCE_POOL_INIT_SIZE	8
+
+//recycled fences of a device, released ones are reset together when no clean fence is left.
+typedef struct _vkh_fence_pool_t {
+	mtx_t					mutex;
+	VkFence*				clean;//unsignaled, ready to be acquired
+	uint32_t				cleanCount;
+	uint32_t				cleanReserved;
+	VkFence*				dirty;//released, to be reset
+	uint32_t				dirtyCount;
+	uint32_t				dirtyReserved;
+}vkh_fence_pool_t;
+
+void vkh_fence_pool_init	(VkhDevice dev);
+void vkh_fence_pool_release	(VkhDevice dev);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
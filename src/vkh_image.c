@@ -21,12 +21,18 @@
  */
 #include "vkh_image.h"
 #include "vkh_device.h"
+#include "vkh_buffer.h"
+#include "vkh_queue.h"
+#include "vkh_stats.h"
 
-VkhImage _vkh_image_create (VkhDevice pDev, VkImageType imageType,
-				  VkFormat format, uint32_t width, uint32_t height,
-				  VkhMemoryUsage memprops, VkImageUsageFlags usage,
-				  VkSampleCountFlagBits samples, VkImageTiling tiling,
-				  uint32_t mipLevels, uint32_t arrayLayers){
+#ifndef MAX
+# define MAX(a,b) (((a) > (b)) ? (a) : (b))
+#endif
+
+static VkhImage _vkh_image_init (VkhDevice pDev, VkImageType imageType,
+				  VkFormat format, uint32_t width, uint32_t height, uint32_t depth,
+				  VkImageUsageFlags usage, VkSampleCountFlagBits samples, VkImageTiling tiling,
+				  uint32_t mipLevels, uint32_t arrayLayers, VkImageCreateFlags flags){
 
 	VkhImage img = (VkhImage)calloc(1,sizeof(vkh_image_t));
 
@@ -34,6 +40,7 @@ VkhImage _vkh_image_create (VkhDevice pDev, VkImageType imageType,
 
 	VkImageCreateInfo* pInfo = &img->infos;
 	pInfo->sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	pInfo->flags			= flags;
 	pInfo->imageType		= imageType;
 	pInfo->tiling			= tiling;
 	pInfo->initialLayout	= (tiling == VK_IMAGE_TILING_OPTIMAL) ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_PREINITIALIZED;
@@ -42,11 +49,34 @@ VkhImage _vkh_image_create (VkhDevice pDev, VkImageType imageType,
 	pInfo->format			= format;
 	pInfo->extent.width		= width;
 	pInfo->extent.height	= height;
-	pInfo->extent.depth		= 1;
+	pInfo->extent.depth		= depth;
 	pInfo->mipLevels		= mipLevels;
 	pInfo->arrayLayers		= arrayLayers;
 	pInfo->samples			= samples;
 
+	if (imageType == VK_IMAGE_TYPE_3D)
+		img->viewType = VK_IMAGE_VIEW_TYPE_3D;
+	else if (flags & VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT)//cube arrays are set by their constructor
+		img->viewType = VK_IMAGE_VIEW_TYPE_CUBE;
+	else
+		img->viewType = (arrayLayers > 1) ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+
+	vkh_atomic_init (&img->references, 1);
+	img->ownerFamily = img->releaseFamily = img->acquireFamily = VK_QUEUE_FAMILY_IGNORED;
+	VKH_STAT_ADD(VKH_STAT_IMAGES, 1);
+
+	return img;
+}
+VkhImage _vkh_image_create (VkhDevice pDev, VkImageType imageType,
+				  VkFormat format, uint32_t width, uint32_t height, uint32_t depth,
+				  VkhMemoryUsage memprops, VkImageUsageFlags usage,
+				  VkSampleCountFlagBits samples, VkImageTiling tiling,
+				  uint32_t mipLevels, uint32_t arrayLayers, VkImageCreateFlags flags){
+
+	VkhImage img = _vkh_image_init (pDev, imageType, format, width, height, depth, usage,
+									samples, tiling, mipLevels, arrayLayers, flags);
+	VkImageCreateInfo* pInfo = &img->infos;
+
 	/*
 	img->imported = false;
 	img->alloc	= VK_NULL_HANDLE;
@@ -55,7 +85,8 @@ VkhImage _vkh_image_create (VkhDevice pDev, VkImageType imageType,
 	img->view	= VK_NULL_HANDLE;*/
 #ifdef VKH_USE_VMA
 	VmaAllocationCreateInfo allocInfo = { .usage = (VmaMemoryUsage)memprops };
-	VK_CHECK_RESULT(vmaCreateImage (pDev->allocator, pInfo, &allocInfo, &img->image, &img->alloc, &img->allocInfo));
+	VKH_STAT_ALLOCATION(VK_CHECK_RESULT(vmaCreateImage (pDev->allocator, pInfo, &allocInfo, &img->image, &img->alloc, &img->allocInfo)));
+	img->memSize = img->allocInfo.size;
 #else
 	VK_CHECK_RESULT(vkCreateImage(pDev->dev, pInfo, NULL, &img->image));
 	VkMemoryRequirements memReq;
@@ -63,29 +94,26 @@ VkhImage _vkh_image_create (VkhDevice pDev, VkImageType imageType,
 	VkMemoryAllocateInfo memAllocInfo = { .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
 										  .allocationSize = memReq.size };
 	vkh_memory_type_from_properties(&pDev->phyMemProps, memReq.memoryTypeBits, memprops,&memAllocInfo.memoryTypeIndex);
-	VK_CHECK_RESULT(vkAllocateMemory(pDev->dev, &memAllocInfo, NULL, &img->memory));
+	VKH_STAT_ALLOCATION(VK_CHECK_RESULT(vkAllocateMemory(pDev->dev, &memAllocInfo, NULL, &img->memory)));
 	VK_CHECK_RESULT(vkBindImageMemory(pDev->dev, img->image, img->memory, 0));
+	img->memSize = memReq.size;
 #endif
-
-	mtx_init(&img->mutex, mtx_plain);
-	img->references = 1;
+	img->memprops = memprops;
+	VKH_STAT_MEMORY_ADD(memprops, img->memSize);
 
 	return img;
 }
-void vkh_image_destroy(VkhImage img)
-{
-	if (img==NULL)
-		return;
-
-	mtx_lock (&img->mutex);
-	img->references--;
-	if (img->references > 0) {
-		mtx_unlock (&img->mutex);
-		return;
-	}
-
-	mtx_unlock (&img->mutex);
-	mtx_destroy (&img->mutex);
+//create a VkImage with no memory bound, memory has to be provided later, for ex. by a VkhAliasPool
+VkhImage vkh_image_create_unbound (VkhDevice pDev, VkFormat format, uint32_t width, uint32_t height,
+								   VkImageTiling tiling, VkImageUsageFlags usage){
+	VkhImage img = _vkh_image_init (pDev, VK_IMAGE_TYPE_2D, format, width, height, 1, usage,
+									VK_SAMPLE_COUNT_1_BIT, tiling, 1, 1, 0);
+	VK_CHECK_RESULT(vkCreateImage(pDev->dev, &img->infos, NULL, &img->image));
+	return img;
+}
+static void _vkh_image_free (VkhImage img) {
+	VKH_STAT_MEMORY_ADD(img->memprops, -(int64_t)img->memSize);
+	VKH_STAT_ADD(VKH_STAT_IMAGES, -1);
 
 	if(img->view != VK_NULL_HANDLE)
 		vkDestroyImageView (img->pDev->dev,img->view, NULL);
@@ -94,7 +122,10 @@ void vkh_image_destroy(VkhImage img)
 
 	if (!img->imported) {
 #ifdef VKH_USE_VMA
-		vmaDestroyImage	(img->pDev->allocator, img->image, img->alloc);
+		if (img->alloc == VK_NULL_HANDLE)//memory not owned (unbound or aliased)
+			vkDestroyImage	(img->pDev->dev, img->image, NULL);
+		else
+			vmaDestroyImage	(img->pDev->allocator, img->image, img->alloc);
 #else
 		vkDestroyImage	(img->pDev->dev, img->image, NULL);
 		vkFreeMemory	(img->pDev->dev, img->memory, NULL);
@@ -106,24 +137,92 @@ void vkh_image_destroy(VkhImage img)
 	free(img);
 	img = NULL;
 }
+static void _vkh_image_release (VkhImage img, bool recycle) {
+	if (img==NULL)
+		return;
+	if (!recycle)
+		img->unrecyclable = true;
+
+	//release makes this thread writes visible to the one dropping the last reference
+	if (vkh_atomic_fetch_sub_explicit (&img->references, 1, vkh_memory_order_release) > 1)
+		return;
+	vkh_atomic_thread_fence (vkh_memory_order_acquire);
+
+	if (!img->unrecyclable && vkh_device_release_hook (img->pDev, VK_OBJECT_TYPE_IMAGE, img)) {
+		vkh_atomic_store_explicit (&img->references, 1, vkh_memory_order_relaxed);
+		return;
+	}
+	_vkh_image_free (img);
+}
+void vkh_image_destroy (VkhImage img) {
+	_vkh_image_release (img, true);
+}
+/**
+ * @brief release a reference without ever handing the image to the release hook. Used by recyclers to evict
+ * the images they kept and by vkh for the images it owns.
+ */
+void vkh_image_destroy_force (VkhImage img) {
+	_vkh_image_release (img, false);
+}
 void vkh_image_reference (VkhImage img) {
-	mtx_lock	(&img->mutex);
-	img->references++;
-	mtx_unlock	(&img->mutex);
+	vkh_atomic_fetch_add_explicit (&img->references, 1, vkh_memory_order_relaxed);
 }
 VkhImage vkh_tex2d_array_create (VkhDevice pDev,
 							 VkFormat format, uint32_t width, uint32_t height, uint32_t layers,
 							 VkhMemoryUsage memprops, VkImageUsageFlags usage){
-	return _vkh_image_create (pDev, VK_IMAGE_TYPE_2D, format, width, height, memprops,usage,
-		VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, 1, layers);
+	return _vkh_image_create (pDev, VK_IMAGE_TYPE_2D, format, width, height, 1, memprops,usage,
+		VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, 1, layers, 0);
+}
+//levels down to 1x1
+static uint32_t _full_mip_chain (uint32_t width, uint32_t height) {
+	uint32_t levels = 1;
+	for (uint32_t size = MAX(width, height); size > 1; size >>= 1)
+		levels++;
+	return levels;
+}
+VkhImage vkh_tex2d_array_create_mipmapped (VkhDevice pDev,
+							 VkFormat format, uint32_t width, uint32_t height, uint32_t layers, uint32_t mipLevels,
+							 VkhMemoryUsage memprops, VkImageUsageFlags usage){
+	uint32_t maxLevels = _full_mip_chain (width, height);
+	if (mipLevels == 0 || mipLevels > maxLevels)
+		mipLevels = maxLevels;
+	return _vkh_image_create (pDev, VK_IMAGE_TYPE_2D, format, width, height, 1, memprops,usage,
+		VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, mipLevels, layers, 0);
+}
+VkhImage vkh_tex2d_create_mipmapped (VkhDevice pDev,
+							 VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels,
+							 VkhMemoryUsage memprops, VkImageUsageFlags usage){
+	return vkh_tex2d_array_create_mipmapped (pDev, format, width, height, 1, mipLevels, memprops, usage);
+}
+VkhImage vkh_tex3d_create (VkhDevice pDev,
+							 VkFormat format, uint32_t width, uint32_t height, uint32_t depth,
+							 VkhMemoryUsage memprops, VkImageUsageFlags usage){
+	return _vkh_image_create (pDev, VK_IMAGE_TYPE_3D, format, width, height, depth, memprops,usage,
+		VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, 1, 1, 0);
+}
+VkhImage vkh_texcube_create (VkhDevice pDev,
+							 VkFormat format, uint32_t size,
+							 VkhMemoryUsage memprops, VkImageUsageFlags usage){
+	return _vkh_image_create (pDev, VK_IMAGE_TYPE_2D, format, size, size, 1, memprops,usage,
+		VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, 1, 6, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
+}
+//cubeCount cubes of 6 faces each, layer index is (cube * 6 + face)
+VkhImage vkh_texcube_array_create (VkhDevice pDev,
+							 VkFormat format, uint32_t size, uint32_t cubeCount,
+							 VkhMemoryUsage memprops, VkImageUsageFlags usage){
+	VkhImage img = _vkh_image_create (pDev, VK_IMAGE_TYPE_2D, format, size, size, 1, memprops,usage,
+		VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, 1, 6 * cubeCount, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
+	//samplerCubeArray even for a single cube
+	img->viewType = VK_IMAGE_VIEW_TYPE_CUBE_ARRAY;
+	return img;
 }
 VkhImage vkh_image_create (VkhDevice pDev,
 						   VkFormat format, uint32_t width, uint32_t height, VkImageTiling tiling,
 						   VkhMemoryUsage memprops,
 						   VkImageUsageFlags usage)
 {
-	return _vkh_image_create (pDev, VK_IMAGE_TYPE_2D, format, width, height, memprops,usage,
-					  VK_SAMPLE_COUNT_1_BIT, tiling, 1, 1);
+	return _vkh_image_create (pDev, VK_IMAGE_TYPE_2D, format, width, height, 1, memprops,usage,
+					  VK_SAMPLE_COUNT_1_BIT, tiling, 1, 1, 0);
 }
 //create vkhImage from existing VkImage
 VkhImage vkh_image_import (VkhDevice pDev, VkImage vkImg, VkFormat format, uint32_t width, uint32_t height) {
@@ -141,9 +240,10 @@ VkhImage vkh_image_import (VkhDevice pDev, VkImage vkImg, VkFormat format, uint3
 	pInfo->mipLevels		= 1;
 	pInfo->arrayLayers		= 1;
 	//pInfo->samples		= samples;
-	img->references			= 1;
-
-	mtx_init (&img->mutex, mtx_plain);
+	img->viewType			= VK_IMAGE_VIEW_TYPE_2D;
+	vkh_atomic_init (&img->references, 1);
+	img->ownerFamily = img->releaseFamily = img->acquireFamily = VK_QUEUE_FAMILY_IGNORED;
+	VKH_STAT_ADD(VKH_STAT_IMAGES, 1);
 
 	return img;
 }
@@ -151,8 +251,8 @@ VkhImage vkh_image_ms_create(VkhDevice pDev,
 						   VkFormat format, VkSampleCountFlagBits num_samples, uint32_t width, uint32_t height,
 						   VkhMemoryUsage memprops,
 						   VkImageUsageFlags usage){
-   return  _vkh_image_create (pDev, VK_IMAGE_TYPE_2D, format, width, height, memprops,usage,
-					  num_samples, VK_IMAGE_TILING_OPTIMAL, 1, 1);
+   return  _vkh_image_create (pDev, VK_IMAGE_TYPE_2D, format, width, height, 1, memprops,usage,
+					  num_samples, VK_IMAGE_TILING_OPTIMAL, 1, 1, 0);
 }
 void vkh_image_create_view (VkhImage img, VkImageViewType viewType, VkImageAspectFlags aspectFlags){
 	if(img->view != VK_NULL_HANDLE)
@@ -163,7 +263,7 @@ void vkh_image_create_view (VkhImage img, VkImageViewType viewType, VkImageAspec
 										 .viewType = viewType,
 										 .format = img->infos.format,
 										 .components = {VK_COMPONENT_SWIZZLE_R,VK_COMPONENT_SWIZZLE_G,VK_COMPONENT_SWIZZLE_B,VK_COMPONENT_SWIZZLE_A},
-										 .subresourceRange = {aspectFlags,0,1,0,img->infos.arrayLayers}};
+										 .subresourceRange = {aspectFlags,0,img->infos.mipLevels,0,img->infos.arrayLayers}};
 	VK_CHECK_RESULT(vkCreateImageView(img->pDev->dev, &viewInfo, NULL, &img->view));
 }
 void vkh_image_create_sampler (VkhImage img, VkFilter magFilter, VkFilter minFilter,
@@ -202,6 +302,9 @@ VkImageView vkh_image_get_view (VkhImage img){
 		return NULL;
 	return img->view;
 }
+VkImageViewType vkh_image_get_view_type (VkhImage img){
+	return img->viewType;
+}
 VkImageLayout vkh_image_get_layout (VkhImage img){
 	if (img == NULL)
 		return VK_IMAGE_LAYOUT_UNDEFINED;
@@ -220,6 +323,13 @@ void vkh_image_set_layout(VkCommandBuffer cmdBuff, VkhImage image, VkImageAspect
 	VkImageSubresourceRange subres = {aspectMask,0,1,0,1};
 	vkh_image_set_layout_subres(cmdBuff, image, subres, old_image_layout, new_image_layout, src_stages, dest_stages);
 }
+//transition every mip level and array layer, all six faces for cube maps
+void vkh_image_set_layout_all(VkCommandBuffer cmdBuff, VkhImage image, VkImageAspectFlags aspectMask,
+						  VkImageLayout old_image_layout, VkImageLayout new_image_layout,
+					  VkPipelineStageFlags src_stages, VkPipelineStageFlags dest_stages) {
+	VkImageSubresourceRange subres = {aspectMask,0,image->infos.mipLevels,0,image->infos.arrayLayers};
+	vkh_image_set_layout_subres(cmdBuff, image, subres, old_image_layout, new_image_layout, src_stages, dest_stages);
+}
 // This method is based on https://github.com/SaschaWillems/Vulkan/blob/master/base/VulkanTools.h#L88
 void vkh_image_set_layout_subres(VkCommandBuffer cmdBuff, VkhImage image, VkImageSubresourceRange subresourceRange,
 							 VkImageLayout old_image_layout, VkImageLayout new_image_layout,
@@ -267,8 +377,104 @@ void vkh_image_set_layout_subres(VkCommandBuffer cmdBuff, VkhImage image, VkImag
 	}
 
 	vkCmdPipelineBarrier(cmdBuff, src_stages, dest_stages, 0, 0, NULL, 0, NULL, 1, &image_memory_barrier);
+	VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
 	image->layout = new_image_layout;
 }
+/**
+ * @brief record the release half of a queue family ownership transfer of an exclusive image to 'dstFamily',
+ * with an optional layout transition. Must be followed by @ref vkh_image_cmd_acquire on a queue of 'dstFamily',
+ * after a semaphore signaled by the submission of 'cmd'. Only the acquire barrier is recorded if the image content
+ * has no owner yet or is already owned by 'dstFamily'.
+ * @param srcStages stages writing the image on the releasing queue.
+ */
+void vkh_image_cmd_release (VkhImage img, VkCommandBuffer cmd, VkImageAspectFlags aspectMask, uint32_t dstFamily,
+							VkImageLayout newLayout, VkPipelineStageFlags srcStages) {
+	img->acquireFamily	= dstFamily;
+	img->releaseLayout	= img->layout;
+	img->acquireLayout	= newLayout;
+	if (img->ownerFamily == VK_QUEUE_FAMILY_IGNORED || img->ownerFamily == dstFamily) {
+		img->releaseFamily = VK_QUEUE_FAMILY_IGNORED;
+		return;
+	}
+	img->releaseFamily = img->ownerFamily;
+	VkImageMemoryBarrier barrier = { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+									 .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+									 .oldLayout = img->releaseLayout,
+									 .newLayout = newLayout,
+									 .srcQueueFamilyIndex = img->releaseFamily,
+									 .dstQueueFamilyIndex = dstFamily,
+									 .image = img->image,
+									 .subresourceRange = {aspectMask, 0, img->infos.mipLevels, 0, img->infos.arrayLayers}};
+	vkCmdPipelineBarrier (cmd, srcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+	VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
+}
+/**
+ * @brief record the acquire half of the transfer started with @ref vkh_image_cmd_release, in a command buffer
+ * submitted on the destination family after the release submission. Image ends in the layout given on release.
+ * @param dstStages first stages using the image on the acquiring queue.
+ * @param dstAccess first accesses to the image on the acquiring queue.
+ */
+void vkh_image_cmd_acquire (VkhImage img, VkCommandBuffer cmd, VkImageAspectFlags aspectMask,
+							VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+	VkImageMemoryBarrier barrier = { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+									 .dstAccessMask = dstAccess,
+									 .oldLayout = img->releaseLayout,
+									 .newLayout = img->acquireLayout,
+									 .srcQueueFamilyIndex = img->releaseFamily,
+									 .dstQueueFamilyIndex = img->acquireFamily,
+									 .image = img->image,
+									 .subresourceRange = {aspectMask, 0, img->infos.mipLevels, 0, img->infos.arrayLayers}};
+	//the semaphore wait orders the acquire after the release
+	VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	if (img->releaseFamily == VK_QUEUE_FAMILY_IGNORED) {
+		//no release, plain barrier on the destination queue
+		barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.srcAccessMask		= VK_ACCESS_MEMORY_WRITE_BIT;
+		srcStages					= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	}
+	vkCmdPipelineBarrier (cmd, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1, &barrier);
+	VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
+	img->layout			= img->acquireLayout;
+	img->ownerFamily	= img->acquireFamily;
+	img->releaseFamily	= VK_QUEUE_FAMILY_IGNORED;
+}
+/**
+ * @brief record the first half of a split layout transition right after the last use of the image, by signaling
+ * 'evt'. Independent work recorded before @ref vkh_image_cmd_wait_layout overlaps with the transition.
+ * @param srcStages stages of the last use, srcAccess its accesses.
+ * @param dstStages first stages of the next use, dstAccess its accesses.
+ */
+void vkh_image_cmd_signal_layout (VkhImage img, VkCommandBuffer cmd, VkEvent evt, VkImageAspectFlags aspectMask,
+								  VkImageLayout newLayout, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+								  VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+	img->splitBarrier = (VkImageMemoryBarrier) { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+												 .srcAccessMask = srcAccess,
+												 .dstAccessMask = dstAccess,
+												 .oldLayout = img->layout,
+												 .newLayout = newLayout,
+												 .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+												 .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+												 .image = img->image,
+												 .subresourceRange = {aspectMask, 0, img->infos.mipLevels, 0, img->infos.arrayLayers}};
+	img->splitSrcStages = srcStages;
+	img->splitDstStages = dstStages;
+	vkh_cmd_split_barrier (img->pDev, cmd, evt, false, srcStages, dstStages, NULL, &img->splitBarrier);
+}
+/**
+ * @brief record the second half of the split transition just before the next use of the image, in the same queue,
+ * 'evt' is reset afterward. The image is in the layout given to @ref vkh_image_cmd_signal_layout.
+ */
+void vkh_image_cmd_wait_layout (VkhImage img, VkCommandBuffer cmd, VkEvent evt) {
+	vkh_cmd_split_barrier (img->pDev, cmd, evt, true, img->splitSrcStages, img->splitDstStages, NULL, &img->splitBarrier);
+	img->layout = img->splitBarrier.newLayout;
+}
+//declare the queue family using the image content, for ex. after its first use on a queue.
+void vkh_image_set_owner_family (VkhImage img, uint32_t qFamIndex) {
+	img->ownerFamily = qFamIndex;
+}
+uint32_t vkh_image_get_owner_family (VkhImage img) {
+	return img->ownerFamily;
+}
 void vkh_image_destroy_sampler (VkhImage img) {
 	if (img==NULL)
 		return;
@@ -302,3 +508,197 @@ uint64_t vkh_image_get_stride (VkhImage img) {
 	vkGetImageSubresourceLayout(img->pDev->dev, img->image, &subres, &layout);
 	return (uint64_t) layout.rowPitch;
 }
+
+static bool _host_copy_available (VkhImage img) {
+#ifdef VK_EXT_host_image_copy
+	return vkh_device_host_image_copy_supported (img->pDev) && (img->infos.usage & VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT);
+#else
+	return false;
+#endif
+}
+//host transitions start from an undefined content or a copy source layout and end in a copy destination layout.
+static bool _host_transition_supported (VkhImage img, VkImageLayout newLayout) {
+	if (img->layout == newLayout)
+		return true;
+	bool oldSupported = img->layout == VK_IMAGE_LAYOUT_UNDEFINED || img->layout == VK_IMAGE_LAYOUT_PREINITIALIZED ||
+						vkh_device_host_copy_layout_supported (img->pDev, img->layout, false);
+	return oldSupported && vkh_device_host_copy_layout_supported (img->pDev, newLayout, true);
+}
+bool vkh_image_host_set_layout (VkhImage img, VkImageAspectFlags aspectMask, VkImageLayout new_image_layout) {
+	if (!_host_copy_available (img) || !_host_transition_supported (img, new_image_layout))
+		return false;
+#ifdef VK_EXT_host_image_copy
+	if (img->layout == new_image_layout)
+		return true;
+	VkHostImageLayoutTransitionInfoEXT info = { .sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT,
+												.image = img->image,
+												.oldLayout = img->layout,
+												.newLayout = new_image_layout,
+												.subresourceRange = {aspectMask, 0, img->infos.mipLevels, 0, img->infos.arrayLayers}};
+	VK_CHECK_RESULT(img->pDev->TransitionImageLayoutEXT (img->pDev->dev, 1, &info));
+	img->layout = new_image_layout;
+#endif
+	return true;
+}
+//bytes per texel of the uncompressed core formats, 0 if unknown. Formats are grouped by enum ranges.
+static VkDeviceSize _format_texel_size (VkFormat format) {
+	if (format == VK_FORMAT_UNDEFINED)
+		return 0;
+	if (format <= VK_FORMAT_R4G4_UNORM_PACK8)
+		return 1;
+	if (format <= VK_FORMAT_A1R5G5B5_UNORM_PACK16)
+		return 2;
+	if (format <= VK_FORMAT_R8_SRGB)
+		return 1;
+	if (format <= VK_FORMAT_R8G8_SRGB)
+		return 2;
+	if (format <= VK_FORMAT_B8G8R8_SRGB)
+		return 3;
+	if (format <= VK_FORMAT_A2B10G10R10_SINT_PACK32)
+		return 4;
+	if (format <= VK_FORMAT_R16_SFLOAT)
+		return 2;
+	if (format <= VK_FORMAT_R16G16_SFLOAT)
+		return 4;
+	if (format <= VK_FORMAT_R16G16B16_SFLOAT)
+		return 6;
+	if (format <= VK_FORMAT_R16G16B16A16_SFLOAT)
+		return 8;
+	if (format <= VK_FORMAT_R32_SFLOAT)
+		return 4;
+	if (format <= VK_FORMAT_R32G32_SFLOAT)
+		return 8;
+	if (format <= VK_FORMAT_R32G32B32_SFLOAT)
+		return 12;
+	if (format <= VK_FORMAT_R32G32B32A32_SFLOAT)
+		return 16;
+	if (format <= VK_FORMAT_R64_SFLOAT)
+		return 8;
+	if (format <= VK_FORMAT_R64G64_SFLOAT)
+		return 16;
+	if (format <= VK_FORMAT_R64G64B64_SFLOAT)
+		return 24;
+	if (format <= VK_FORMAT_R64G64B64A64_SFLOAT)
+		return 32;
+	if (format <= VK_FORMAT_E5B9G9R9_UFLOAT_PACK32)
+		return 4;
+	if (format == VK_FORMAT_D16_UNORM)
+		return 2;
+	if (format <= VK_FORMAT_D32_SFLOAT)
+		return 4;
+	if (format == VK_FORMAT_S8_UINT)
+		return 1;
+	return 0;
+}
+//bytes copied by the full copy region, 0 if the format is not handled.
+static VkDeviceSize _full_copy_size (VkhImage img) {
+	VkExtent3D* e = &img->infos.extent;
+	return _format_texel_size (img->infos.format) * e->width * e->height * e->depth * img->infos.arrayLayers;
+}
+//the caller buffer has to hold the whole first mip of all layers.
+static bool _copy_size_valid (VkhImage img, VkDeviceSize size, const char* caller) {
+	VkDeviceSize required = _full_copy_size (img);
+	if (required == 0) {
+		fprintf (stderr, "%s: unsupported image format (%d)\n", caller, img->infos.format);
+		return false;
+	}
+	if (size < required) {
+		fprintf (stderr, "%s: size (%lu) smaller than the image content (%lu)\n", caller,
+				 (unsigned long)size, (unsigned long)required);
+		assert (size >= required);
+		return false;
+	}
+	return true;
+}
+static VkBufferImageCopy _full_copy_region (VkhImage img) {
+	VkBufferImageCopy region = { .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, img->infos.arrayLayers},
+								 .imageExtent = img->infos.extent };
+	return region;
+}
+void vkh_image_copy_from_memory (VkhImage img, VkhQueue queue, const void* data, VkDeviceSize size, VkImageLayout finalLayout) {
+	if (!_copy_size_valid (img, size, "vkh_image_copy_from_memory"))
+		return;
+	size = _full_copy_size (img);
+#ifdef VK_EXT_host_image_copy
+	if (_host_copy_available (img) && _host_transition_supported (img, finalLayout)) {
+		vkh_image_host_set_layout (img, VK_IMAGE_ASPECT_COLOR_BIT, finalLayout);
+		VkMemoryToImageCopyEXT region = { .sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT,
+										  .pHostPointer = data,
+										  .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, img->infos.arrayLayers},
+										  .imageExtent = img->infos.extent };
+		VkCopyMemoryToImageInfoEXT info = { .sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT,
+											.dstImage = img->image,
+											.dstImageLayout = finalLayout,
+											.regionCount = 1,
+											.pRegions = &region };
+		VK_CHECK_RESULT(img->pDev->CopyMemoryToImageEXT (img->pDev->dev, &info));
+		return;
+	}
+#endif
+	VkhDevice dev = img->pDev;
+	VkhBuffer stagingBuff = vkh_buffer_create (dev, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VKH_MEMORY_USAGE_CPU_ONLY, size);
+	VK_CHECK_RESULT(vkh_buffer_map (stagingBuff));
+	memcpy (stagingBuff->mapped, data, size);
+	vkh_buffer_unmap (stagingBuff);
+
+	VkCommandBuffer cmd = vkh_immediate_begin (queue);
+	VkImageSubresourceRange subres = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, img->infos.arrayLayers};
+	VkBufferImageCopy region = _full_copy_region (img);
+
+	vkh_image_set_layout_subres (cmd, img, subres, img->layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+								 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	vkCmdCopyBufferToImage (cmd, stagingBuff->buffer, img->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	vkh_image_set_layout_subres (cmd, img, subres, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout,
+								 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	vkh_immediate_end (queue, cmd);
+	img->ownerFamily = queue->familyIndex;
+
+	vkh_buffer_destroy_force (stagingBuff);
+}
+void vkh_image_copy_to_memory (VkhImage img, VkhQueue queue, void* data, VkDeviceSize size) {
+	if (img->layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+		fprintf (stderr, "vkh_image_copy_to_memory: image content is undefined\n");
+		return;
+	}
+	if (!_copy_size_valid (img, size, "vkh_image_copy_to_memory"))
+		return;
+	size = _full_copy_size (img);
+#ifdef VK_EXT_host_image_copy
+	if (_host_copy_available (img) && vkh_device_host_copy_layout_supported (img->pDev, img->layout, false)) {
+		VkImageToMemoryCopyEXT region = { .sType = VK_STRUCTURE_TYPE_IMAGE_TO_MEMORY_COPY_EXT,
+										  .pHostPointer = data,
+										  .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, img->infos.arrayLayers},
+										  .imageExtent = img->infos.extent };
+		VkCopyImageToMemoryInfoEXT info = { .sType = VK_STRUCTURE_TYPE_COPY_IMAGE_TO_MEMORY_INFO_EXT,
+											.srcImage = img->image,
+											.srcImageLayout = img->layout,
+											.regionCount = 1,
+											.pRegions = &region };
+		VK_CHECK_RESULT(img->pDev->CopyImageToMemoryEXT (img->pDev->dev, &info));
+		return;
+	}
+#endif
+	VkhDevice dev = img->pDev;
+	VkImageLayout layout = img->layout;
+	VkhBuffer stagingBuff = vkh_buffer_create (dev, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VKH_MEMORY_USAGE_GPU_TO_CPU, size);
+
+	VkCommandBuffer cmd = vkh_immediate_begin (queue);
+	VkImageSubresourceRange subres = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, img->infos.arrayLayers};
+	VkBufferImageCopy region = _full_copy_region (img);
+
+	vkh_image_set_layout_subres (cmd, img, subres, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+								 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	vkCmdCopyImageToBuffer (cmd, img->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuff->buffer, 1, &region);
+	if (layout != VK_IMAGE_LAYOUT_PREINITIALIZED)
+		vkh_image_set_layout_subres (cmd, img, subres, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout,
+									 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	vkh_immediate_end (queue, cmd);
+
+	VK_CHECK_RESULT(vkh_buffer_map (stagingBuff));
+#ifdef VKH_USE_VMA
+	vmaInvalidateAllocation (dev->allocator, stagingBuff->alloc, 0, VK_WHOLE_SIZE);
+#endif
+	memcpy (data, stagingBuff->mapped, size);
+	vkh_buffer_unmap (stagingBuff);
+	vkh_buffer_destroy_force (stagingBuff);
+}
@@ -28,7 +28,7 @@ extern "C" {
 
 #include "vkh.h"
 #include "vk_mem_alloc.h"
-#include "deps/tinycthread.h"
+#include "vkh_atomic.h"
 
 typedef struct _vkh_image_t {
 	VkhDevice				pDev;
@@ -42,11 +42,22 @@ typedef struct _vkh_image_t {
 #endif
 	VkSampler				sampler;
 	VkImageView				view;
+	VkImageViewType			viewType;//default view type deduced from image type and create flags
 	VkImageLayout			layout; //current layout
 	bool					imported;//dont destroy vkimage at end
+	uint32_t				ownerFamily;//queue family owning the image content, VK_QUEUE_FAMILY_IGNORED if unknown
+	uint32_t				releaseFamily;//family released by vkh_image_cmd_release, VK_QUEUE_FAMILY_IGNORED if no release barrier
+	uint32_t				acquireFamily;//family the pending transfer targets
+	VkImageLayout			releaseLayout;//layout transition of the pending transfer, repeated by both halves
+	VkImageLayout			acquireLayout;
+	VkImageMemoryBarrier	splitBarrier;//pending split barrier signaled by vkh_image_cmd_signal_layout
+	VkPipelineStageFlags	splitSrcStages;
+	VkPipelineStageFlags	splitDstStages;
+	VkhMemoryUsage			memprops;
+	VkDeviceSize			memSize;//size of the owned allocation, 0 if unbound, aliased or imported
 
-	uint32_t				references;
-	mtx_t					mutex;
+	vkh_atomic_uint			references;
+	bool					unrecyclable;//released by its owner with vkh_image_destroy_force, the release hook is skipped
 }vkh_image_t;
 
 #ifdef __cplusplus
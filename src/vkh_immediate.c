@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vkh_immediate.h"
+#include "vkh_device.h"
+#include "vkh_queue.h"
+
+static vkh_immediate_t* _get_context (VkhQueue queue) {
+	VkhDevice dev = queue->dev;
+	mtx_lock (&dev->immediateMutex);
+	vkh_immediate_t* im = dev->immediates[queue->familyIndex];
+	if (im == NULL) {
+		im = (vkh_immediate_t*)calloc(1, sizeof(vkh_immediate_t));
+		im->qFamIndex = queue->familyIndex;
+		mtx_init (&im->mutex, mtx_plain);
+		dev->immediates[queue->familyIndex] = im;
+	}
+	mtx_unlock (&dev->immediateMutex);
+	return im;
+}
+//must be called with the context locked.
+static vkh_immediate_slot_t* _find_slot (vkh_immediate_t* im, VkCommandBuffer cmd) {
+	for (uint32_t i=0; i<im->count; i++) {
+		if (im->slots[i].cmd == cmd)
+			return &im->slots[i];
+	}
+	fprintf (stderr, "vkh_immediate: command buffer not obtained with vkh_immediate_begin\n");
+	return NULL;
+}
+/**
+ * @brief get a primary command buffer in recording state for a one-shot submission on 'queue'.
+ * Command buffers and fences are recycled per queue family once their previous submission has completed.
+ */
+VkCommandBuffer vkh_immediate_begin (VkhQueue queue) {
+	VkhDevice dev = queue->dev;
+	vkh_immediate_t* im = _get_context (queue);
+	vkh_immediate_slot_t* slot = NULL;
+
+	mtx_lock (&im->mutex);
+	for (uint32_t i=0; i<im->count && !slot; i++) {
+		vkh_immediate_slot_t* s = &im->slots[i];
+		if (s->recording || s->waiters > 0)
+			continue;
+		if (s->value == 0 || vkGetFenceStatus (dev->dev, s->fence) == VK_SUCCESS)
+			slot = s;
+	}
+	if (!slot) {
+		im->slots = (vkh_immediate_slot_t*)realloc(im->slots, (im->count + VKH_IMMEDIATE_CHUNK) * sizeof(vkh_immediate_slot_t));
+		for (uint32_t i=im->count; i<im->count + VKH_IMMEDIATE_CHUNK; i++) {
+			vkh_immediate_slot_t* s = &im->slots[i];
+			memset (s, 0, sizeof(vkh_immediate_slot_t));
+			s->pool		= vkh_cmd_pool_create (dev, im->qFamIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+			s->cmd		= vkh_cmd_buff_create (dev, s->pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+			s->fence	= vkh_fence_create (dev);
+		}
+		slot = &im->slots[im->count];
+		im->count += VKH_IMMEDIATE_CHUNK;
+	}
+	slot->recording = true;
+	bool reset = slot->value != 0;
+	VkCommandPool pool = slot->pool;
+	VkFence fence = slot->fence;
+	VkCommandBuffer cmd = slot->cmd;
+	mtx_unlock (&im->mutex);
+
+	//slot is owned by the caller until it is submitted, no need to keep the lock.
+	if (reset) {
+		VK_CHECK_RESULT(vkResetFences (dev->dev, 1, &fence));
+		VK_CHECK_RESULT(vkResetCommandPool (dev->dev, pool, 0));
+	}
+	vkh_cmd_begin (cmd, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	return cmd;
+}
+/**
+ * @brief end and submit a command buffer obtained with @ref vkh_immediate_begin without waiting.
+ * @return a value increasing with each submission of the queue family to give to @ref vkh_immediate_wait.
+ */
+uint64_t vkh_immediate_end_async (VkhQueue queue, VkCommandBuffer cmd) {
+	vkh_immediate_t* im = _get_context (queue);
+	vkh_cmd_end (cmd);
+
+	mtx_lock (&im->mutex);
+	vkh_immediate_slot_t* slot = _find_slot (im, cmd);
+	if (!slot) {
+		mtx_unlock (&im->mutex);
+		return 0;
+	}
+	slot->value		= ++im->submitted;
+	slot->recording	= false;
+	uint64_t value = slot->value;
+	vkh_cmd_submit (queue, &cmd, slot->fence);
+	mtx_unlock (&im->mutex);
+	return value;
+}
+//end and submit a command buffer obtained with vkh_immediate_begin and wait for its completion.
+void vkh_immediate_end (VkhQueue queue, VkCommandBuffer cmd) {
+	vkh_immediate_wait (queue, vkh_immediate_end_async (queue, cmd));
+}
+/**
+ * @brief wait for the submission identified by 'value' returned by @ref vkh_immediate_end_async.
+ * Returns immediately if the slot has already been recycled, which implies completion.
+ */
+void vkh_immediate_wait (VkhQueue queue, uint64_t value) {
+	if (value == 0)
+		return;
+	vkh_immediate_t* im = _get_context (queue);
+	vkh_immediate_slot_t* slot = NULL;
+
+	mtx_lock (&im->mutex);
+	for (uint32_t i=0; i<im->count && !slot; i++) {
+		if (im->slots[i].value == value && !im->slots[i].recording)
+			slot = &im->slots[i];
+	}
+	if (!slot) {
+		mtx_unlock (&im->mutex);
+		return;
+	}
+	slot->waiters++;
+	VkFence fence = slot->fence;
+	uint32_t idx = (uint32_t)(slot - im->slots);
+	mtx_unlock (&im->mutex);
+
+	VK_CHECK_RESULT(vkWaitForFences (queue->dev->dev, 1, &fence, VK_TRUE, UINT64_MAX));
+
+	mtx_lock (&im->mutex);
+	im->slots[idx].waiters--;
+	mtx_unlock (&im->mutex);
+}
+//wait for pending submissions and destroy the immediate contexts of the device.
+void vkh_immediate_release (VkhDevice dev) {
+	for (uint32_t f=0; f<dev->queueFamilyCount; f++) {
+		vkh_immediate_t* im = dev->immediates[f];
+		if (im == NULL)
+			continue;
+		for (uint32_t i=0; i<im->count; i++) {
+			vkh_immediate_slot_t* s = &im->slots[i];
+			if (s->value != 0 && !s->recording)
+				vkWaitForFences (dev->dev, 1, &s->fence, VK_TRUE, UINT64_MAX);
+			vkDestroyFence (dev->dev, s->fence, NULL);
+			vkDestroyCommandPool (dev->dev, s->pool, NULL);
+		}
+		free (im->slots);
+		mtx_destroy (&im->mutex);
+		free (im);
+	}
+	free (dev->immediates);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef VKH_IMMEDIATE_H
+#define VKH_IMMEDIATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "vkh.h"
+#include "deps/tinycthread.h"
+
+#define VKH_IMMEDIATE_CHUNK	8	//slots created at once when none is free
+
+typedef struct {
+	VkCommandPool			pool;
+	VkCommandBuffer			cmd;
+	VkFence					fence;
+	uint64_t				value;//value of the last submission, 0 if never submitted
+	bool					recording;
+	uint32_t				waiters;//threads in vkh_immediate_wait, slot is not recycled until they leave
+}vkh_immediate_slot_t;
+
+//one-shot submission context of a queue family.
+typedef struct _vkh_immediate_t {
+	uint32_t				qFamIndex;
+	uint64_t				submitted;//last value returned by vkh_immediate_end_async
+	mtx_t					mutex;
+	vkh_immediate_slot_t*	slots;
+	uint32_t				count;
+}vkh_immediate_t;
+
+void vkh_immediate_release (VkhDevice dev);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vkh_jobs.h"
+
+#ifndef MIN
+# define MIN(a,b) (((a) < (b)) ? (a) : (b))
+#endif
+
+static _Thread_local vkh_worker_t* currentWorker = NULL;
+
+static bool _deque_push (vkh_job_deque_t* d, vkh_job_t* job) {
+	long long b = vkh_atomic_load_explicit (&d->bottom, vkh_memory_order_relaxed);
+	long long t = vkh_atomic_load_explicit (&d->top, vkh_memory_order_acquire);
+	if (b - t >= VKH_JOB_DEQUE_SIZE)
+		return false;
+	vkh_atomic_ptr_store_explicit (&d->jobs[b & (VKH_JOB_DEQUE_SIZE - 1)], job, vkh_memory_order_relaxed);
+	vkh_atomic_thread_fence (vkh_memory_order_release);
+	vkh_atomic_store_explicit (&d->bottom, b + 1, vkh_memory_order_relaxed);
+	return true;
+}
+static vkh_job_t* _deque_pop (vkh_job_deque_t* d) {
+	long long b = vkh_atomic_load_explicit (&d->bottom, vkh_memory_order_relaxed) - 1;
+	vkh_atomic_store_explicit (&d->bottom, b, vkh_memory_order_relaxed);
+	vkh_atomic_thread_fence (vkh_memory_order_seq_cst);
+	long long t = vkh_atomic_load_explicit (&d->top, vkh_memory_order_relaxed);
+	if (t > b) {//empty
+		vkh_atomic_store_explicit (&d->bottom, b + 1, vkh_memory_order_relaxed);
+		return NULL;
+	}
+	vkh_job_t* job = vkh_atomic_ptr_load_explicit (&d->jobs[b & (VKH_JOB_DEQUE_SIZE - 1)], vkh_memory_order_relaxed);
+	if (t == b) {//last one, race against thieves
+		if (!vkh_atomic_compare_exchange_strong_explicit (&d->top, &t, t + 1, vkh_memory_order_seq_cst, vkh_memory_order_relaxed))
+			job = NULL;
+		vkh_atomic_store_explicit (&d->bottom, b + 1, vkh_memory_order_relaxed);
+	}
+	return job;
+}
+static vkh_job_t* _deque_steal (vkh_job_deque_t* d) {
+	long long t = vkh_atomic_load_explicit (&d->top, vkh_memory_order_acquire);
+	vkh_atomic_thread_fence (vkh_memory_order_seq_cst);
+	long long b = vkh_atomic_load_explicit (&d->bottom, vkh_memory_order_acquire);
+	if (t >= b)
+		return NULL;
+	vkh_job_t* job = vkh_atomic_ptr_load_explicit (&d->jobs[t & (VKH_JOB_DEQUE_SIZE - 1)], vkh_memory_order_relaxed);
+	if (!vkh_atomic_compare_exchange_strong_explicit (&d->top, &t, t + 1, vkh_memory_order_seq_cst, vkh_memory_order_relaxed))
+		return NULL;//lost the race
+	return job;
+}
+
+static void _run (VkhJobSystem js, vkh_job_t* job);
+
+static void _push (VkhJobSystem js, vkh_job_t* job) {
+	vkh_worker_t* w = currentWorker;
+	vkh_atomic_fetch_add (&js->queued, 1);
+	if (w && w->js == js) {
+		if (!_deque_push (&w->deque, job)) {
+			vkh_atomic_fetch_sub (&js->queued, 1);
+			_run (js, job);
+			return;
+		}
+		if (vkh_atomic_load (&js->sleepers) > 0) {
+			mtx_lock (&js->mutex);
+			cnd_signal (&js->wakeup);
+			mtx_unlock (&js->mutex);
+		}
+		return;
+	}
+	mtx_lock (&js->mutex);
+	if (js->injectedCount == js->injectedCapacity) {
+		uint32_t newCapacity = js->injectedCapacity ? js->injectedCapacity * 2 : 64;
+		vkh_job_t** tmp = (vkh_job_t**)malloc(newCapacity * sizeof(vkh_job_t*));
+		for (uint32_t i=0; i<js->injectedCount; i++)
+			tmp[i] = js->injected[(js->injectedHead + i) % js->injectedCapacity];
+		free (js->injected);
+		js->injected = tmp;
+		js->injectedCapacity = newCapacity;
+		js->injectedHead = 0;
+	}
+	js->injected[(js->injectedHead + js->injectedCount) % js->injectedCapacity] = job;
+	js->injectedCount++;
+	cnd_signal (&js->wakeup);
+	mtx_unlock (&js->mutex);
+}
+static vkh_job_t* _take (VkhJobSystem js, vkh_worker_t* self) {
+	vkh_job_t* job = self ? _deque_pop (&self->deque) : NULL;
+	if (!job) {
+		mtx_lock (&js->mutex);
+		if (js->injectedCount > 0) {
+			job = js->injected[js->injectedHead];
+			js->injectedHead = (js->injectedHead + 1) % js->injectedCapacity;
+			js->injectedCount--;
+		}
+		mtx_unlock (&js->mutex);
+	}
+	if (!job) {
+		uint32_t start = self ? self->index + 1 : 0;
+		for (uint32_t i=0; i<js->workerCount && !job; i++) {
+			vkh_worker_t* victim = &js->workers[(start + i) % js->workerCount];
+			if (victim != self)
+				job = _deque_steal (&victim->deque);
+		}
+	}
+	if (job)
+		vkh_atomic_fetch_sub (&js->queued, 1);
+	return job;
+}
+static void _run (VkhJobSystem js, vkh_job_t* job) {
+	vkh_atomic_uint* pending = job->pending;
+	if (job->rangeFunc) {
+		//keep the left half, hand the right halves to other workers
+		while (job->end - job->begin > job->grain) {
+			uint32_t mid = job->begin + (job->end - job->begin) / 2;
+			vkh_job_t* right = (vkh_job_t*)malloc(sizeof(vkh_job_t));
+			*right = *job;
+			right->begin = mid;
+			job->end = mid;
+			vkh_atomic_fetch_add_explicit (pending, 1, vkh_memory_order_relaxed);
+			_push (js, right);
+		}
+		vkh_worker_t* w = currentWorker;
+		job->rangeFunc (job->userData, job->begin, job->end, (w && w->js == js) ? w->index : js->workerCount);
+	} else
+		job->func (job->userData);
+	free (job);
+	vkh_atomic_fetch_sub_explicit (pending, 1, vkh_memory_order_release);
+}
+//run jobs while waiting for the group to complete.
+static void _wait (VkhJobSystem js, vkh_atomic_uint* pending) {
+	vkh_worker_t* w = currentWorker;
+	if (w && w->js != js)
+		w = NULL;
+	while (vkh_atomic_load_explicit (pending, vkh_memory_order_acquire) > 0) {
+		vkh_job_t* job = _take (js, w);
+		if (job)
+			_run (js, job);
+		else
+			thrd_yield ();
+	}
+}
+static int _worker_main (void* arg) {
+	vkh_worker_t* w = (vkh_worker_t*)arg;
+	VkhJobSystem js = w->js;
+	currentWorker = w;
+	while (!vkh_atomic_load (&js->quit)) {
+		vkh_job_t* job = _take (js, w);
+		if (job) {
+			_run (js, job);
+			continue;
+		}
+		mtx_lock (&js->mutex);
+		vkh_atomic_fetch_add (&js->sleepers, 1);
+		while (!vkh_atomic_load (&js->quit) && vkh_atomic_load (&js->queued) == 0)
+			cnd_wait (&js->wakeup, &js->mutex);
+		vkh_atomic_fetch_sub (&js->sleepers, 1);
+		mtx_unlock (&js->mutex);
+	}
+	return 0;
+}
+
+VkhJobSystem vkh_jobs_create (uint32_t workerCount) {
+	VkhJobSystem js = (VkhJobSystem)calloc(1, sizeof(vkh_job_system_t));
+	js->workerCount = workerCount;
+	js->workers = (vkh_worker_t*)calloc(workerCount, sizeof(vkh_worker_t));
+	mtx_init (&js->mutex, mtx_plain);
+	cnd_init (&js->wakeup);
+	for (uint32_t i=0; i<workerCount; i++) {
+		js->workers[i].js = js;
+		js->workers[i].index = i;
+	}
+	for (uint32_t i=0; i<workerCount; i++)
+		thrd_create (&js->workers[i].thread, _worker_main, &js->workers[i]);
+	return js;
+}
+void vkh_jobs_destroy (VkhJobSystem js) {
+	if (js == NULL)
+		return;
+	vkh_jobs_wait (js);
+	mtx_lock (&js->mutex);
+	vkh_atomic_store (&js->quit, true);
+	//bundled tinycthread cnd_broadcast wakes a single thread on posix, wake each worker.
+	for (uint32_t i=0; i<js->workerCount; i++)
+		cnd_signal (&js->wakeup);
+	mtx_unlock (&js->mutex);
+	for (uint32_t i=0; i<js->workerCount; i++)
+		thrd_join (js->workers[i].thread, NULL);
+	cnd_destroy (&js->wakeup);
+	mtx_destroy (&js->mutex);
+	free (js->injected);
+	free (js->workers);
+	free (js);
+}
+uint32_t vkh_jobs_get_worker_count (VkhJobSystem js) {
+	return js->workerCount;
+}
+void vkh_jobs_submit (VkhJobSystem js, VkhJobFunc func, void* userData) {
+	vkh_job_t* job = (vkh_job_t*)calloc(1, sizeof(vkh_job_t));
+	job->func		= func;
+	job->userData	= userData;
+	job->pending	= &js->pending;
+	vkh_atomic_fetch_add_explicit (&js->pending, 1, vkh_memory_order_relaxed);
+	_push (js, job);
+}
+//wait for all the jobs submitted with vkh_jobs_submit, calling thread helps running them.
+void vkh_jobs_wait (VkhJobSystem js) {
+	_wait (js, &js->pending);
+}
+/**
+ * @brief call func on sub ranges of [0,count[ no larger than grain, in parallel, and return when all are done.
+ * workerIndex given to func is in [0,workerCount], workerCount being used for non worker threads.
+ */
+void vkh_jobs_parallel_for (VkhJobSystem js, uint32_t count, uint32_t grain, VkhJobRangeFunc func, void* userData) {
+	if (count == 0)
+		return;
+	vkh_atomic_uint pending;
+	vkh_atomic_init (&pending, 1);
+	vkh_job_t* job = (vkh_job_t*)calloc(1, sizeof(vkh_job_t));
+	job->rangeFunc	= func;
+	job->userData	= userData;
+	job->end		= count;
+	job->grain		= grain ? grain : 1;
+	job->pending	= &pending;
+	_run (js, job);
+	_wait (js, &pending);
+}
+
+typedef struct {
+	VkhCmdAllocator							ca;
+	const VkCommandBufferInheritanceInfo*	inheritance;
+	VkCommandBufferUsageFlags				flags;
+	VkCommandBuffer*						cmds;
+	uint32_t								count;
+	uint32_t								chunkSize;
+	VkhCmdRecordFunc						func;
+	void*									userData;
+}vkh_record_ctx_t;
+
+static void _record_chunks (void* data, uint32_t begin, uint32_t end, uint32_t workerIndex) {
+	vkh_record_ctx_t* ctx = (vkh_record_ctx_t*)data;
+	VkCommandBufferBeginInfo beginInfo = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+										   .flags = ctx->flags,
+										   .pInheritanceInfo = ctx->inheritance };
+	for (uint32_t c = begin; c < end; c++) {
+		VkCommandBuffer cmd = vkh_cmd_allocator_get (ctx->ca, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+		VK_CHECK_RESULT(vkBeginCommandBuffer (cmd, &beginInfo));
+		ctx->func (ctx->userData, cmd, c * ctx->chunkSize, MIN((c + 1) * ctx->chunkSize, ctx->count));
+		VK_CHECK_RESULT(vkEndCommandBuffer (cmd));
+		ctx->cmds[c] = cmd;
+	}
+}
+/**
+ * @brief split [0,count[ in chunks recorded in parallel in secondary command buffers taken from the worker
+ * threads pools of 'ca', then execute them in order in 'primary'.
+ * @param inheritance render pass or dynamic rendering (pNext) state the secondaries continue, primary must be inside
+ * it with secondary command buffers contents.
+ */
+void vkh_cmd_record_parallel (VkhJobSystem js, VkhCmdAllocator ca, VkCommandBuffer primary,
+							  const VkCommandBufferInheritanceInfo* inheritance, uint32_t count, uint32_t chunkSize,
+							  VkhCmdRecordFunc func, void* userData) {
+	if (count == 0)
+		return;
+	if (chunkSize == 0)
+		chunkSize = 1;
+	uint32_t chunks = (count + chunkSize - 1) / chunkSize;
+	vkh_record_ctx_t ctx = {
+		.ca			= ca,
+		.inheritance= inheritance,
+		.flags		= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.cmds		= (VkCommandBuffer*)malloc(chunks * sizeof(VkCommandBuffer)),
+		.count		= count,
+		.chunkSize	= chunkSize,
+		.func		= func,
+		.userData	= userData
+	};
+	if (inheritance->renderPass != VK_NULL_HANDLE)
+		ctx.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+#ifdef VK_VERSION_1_3
+	for (const VkBaseInStructure* s = (const VkBaseInStructure*)inheritance->pNext; s; s = s->pNext)
+		if (s->sType == VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO)
+			ctx.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+#endif
+	vkh_jobs_parallel_for (js, chunks, 1, _record_chunks, &ctx);
+	vkCmdExecuteCommands (primary, chunks, ctx.cmds);
+	free (ctx.cmds);
+}
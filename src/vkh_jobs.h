@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef VKH_JOBS_H
+#define VKH_JOBS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "vkh.h"
+#include "deps/tinycthread.h"
+#include "vkh_atomic.h"
+
+#define VKH_JOB_DEQUE_SIZE	4096	//power of two, a job is run inline if the deque is full
+
+typedef struct _vkh_job_t {
+	VkhJobFunc				func;//single job
+	VkhJobRangeFunc			rangeFunc;//parallel for, range is split until it fits in grain
+	void*					userData;
+	uint32_t				begin;
+	uint32_t				end;
+	uint32_t				grain;
+	vkh_atomic_uint*		pending;//jobs of the group not yet completed
+}vkh_job_t;
+
+//Chase-Lev work stealing deque, owner pushes and pops at bottom, thieves steal at top.
+typedef struct {
+	vkh_atomic_llong		top;
+	vkh_atomic_llong		bottom;
+	vkh_atomic_ptr(vkh_job_t*)	jobs[VKH_JOB_DEQUE_SIZE];
+}vkh_job_deque_t;
+
+typedef struct {
+	struct _vkh_job_system_t*	js;
+	uint32_t				index;
+	thrd_t					thread;
+	vkh_job_deque_t			deque;
+}vkh_worker_t;
+
+typedef struct _vkh_job_system_t {
+	uint32_t				workerCount;
+	vkh_worker_t*			workers;
+	vkh_atomic_bool			quit;
+	vkh_atomic_uint			queued;//jobs pushed and not yet taken, workers sleep when 0
+	vkh_atomic_uint			sleepers;
+	vkh_atomic_uint			pending;//jobs submitted with vkh_jobs_submit not yet completed
+	mtx_t					mutex;//protect injection queue and sleep
+	cnd_t					wakeup;
+	vkh_job_t**				injected;//FIFO ring for jobs pushed from non worker threads
+	uint32_t				injectedCapacity;
+	uint32_t				injectedHead;
+	uint32_t				injectedCount;
+}vkh_job_system_t;
+
+#ifdef __cplusplus
+}
+#endif
+#endif
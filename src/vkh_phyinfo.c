@@ -91,6 +91,8 @@ VkhPhyInfo vkh_phyinfo_create (VkPhysicalDevice phy, VkSurfaceKHR surface) {
 void vkh_phyinfo_destroy (VkhPhyInfo phy) {
 	if (phy->pExtensionProperties != NULL)
 		free(phy->pExtensionProperties);
+	free(phy->qCreateInfos);
+	free(phy->qPriorities);
 	free(phy->queues);
 	free(phy);
 }
@@ -185,6 +187,35 @@ bool vkh_phy_info_create_graphic_queues (VkhPhyInfo phy, uint32_t queueCount, co
 	}
 	return false;
 }
+/**
+ * @brief fill one queue create info per family with all the queues still available in it, for use with a VkhQueueManager.
+ * Must not be mixed with the other vkh_phyinfo_create_xxx_queues functions for the same device.
+ * @return an array of *pQueueInfoCount create infos owned by phy.
+ */
+const VkDeviceQueueCreateInfo* vkh_phyinfo_create_all_queues (VkhPhyInfo phy, uint32_t* pQueueInfoCount) {
+	uint32_t maxCount = 0;
+	for (uint32_t j=0; j<phy->queueCount; j++)
+		maxCount = phy->queues[j].queueCount > maxCount ? phy->queues[j].queueCount : maxCount;
+	free (phy->qPriorities);
+	free (phy->qCreateInfos);
+	phy->qPriorities = (float*)malloc((maxCount ? maxCount : 1) * sizeof(float));
+	for (uint32_t i=0; i<maxCount; i++)
+		phy->qPriorities[i] = 1.0f;
+	phy->qCreateInfos = (VkDeviceQueueCreateInfo*)calloc(phy->queueCount, sizeof(VkDeviceQueueCreateInfo));
+	phy->qCreateInfosCount = 0;
+	for (uint32_t j=0; j<phy->queueCount; j++) {
+		if (phy->queues[j].queueCount == 0)
+			continue;
+		VkDeviceQueueCreateInfo* qInfo = &phy->qCreateInfos[phy->qCreateInfosCount++];
+		qInfo->sType			= VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		qInfo->queueFamilyIndex	= j;
+		qInfo->queueCount		= phy->queues[j].queueCount;
+		qInfo->pQueuePriorities	= phy->qPriorities;
+		phy->queues[j].queueCount = 0;
+	}
+	*pQueueInfoCount = phy->qCreateInfosCount;
+	return phy->qCreateInfos;
+}
 bool vkh_phyinfo_try_get_extension_properties (VkhPhyInfo phy, const char* name, const VkExtensionProperties* properties) {
 	if (phy->pExtensionProperties == NULL) {
 		VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(phy->phy, NULL, &phy->extensionCount, NULL));
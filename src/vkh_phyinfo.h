@@ -41,6 +41,7 @@ typedef struct _vkh_phy_t{
 
 	uint32_t							qCreateInfosCount;
 	VkDeviceQueueCreateInfo*			qCreateInfos;
+	float*								qPriorities;//shared by qCreateInfos
 
 	VkExtensionProperties*				pExtensionProperties;
 	uint32_t							extensionCount;
@@ -22,6 +22,9 @@
 #include "vkh_presenter.h"
 #include "vkh_device.h"
 #include "vkh_image.h"
+#include "vkh_queue.h"
+#include "vkh_stats.h"
+#include <math.h>
 
 #ifndef MIN
 # define MIN(a,b) (((a) < (b)) ? (a) : (b))
@@ -31,87 +34,339 @@
 # define MAX(a,b) (((a) > (b)) ? (a) : (b))
 #endif
 
-#define FENCE_TIMEOUT UINT16_MAX
+#define FENCE_TIMEOUT UINT64_MAX
 
 void vkh_presenter_create_swapchain	 (VkhPresenter r);
 void _swapchain_destroy (VkhPresenter r);
+void _swapchain_retire (VkhPresenter r);
+static void _retired_release (VkhPresenter r, vkh_retired_swapchain_t* sc);
+static void _framebuffers_create (VkhPresenter r);
+static void _readback_create (VkhPresenter r);
+static void _cmd_init_barrier (VkhPresenter r, VkCommandBuffer cmd, uint32_t index);
+static void _frames_deliver (VkhPresenter r);
 void _init_phy_surface	(VkhPresenter r, VkFormat preferedFormat, VkPresentModeKHR presentMode);
 
-VkhPresenter vkh_presenter_create (VkhDevice dev, uint32_t presentQueueFamIdx, VkSurfaceKHR surface, uint32_t width, uint32_t height,
+static void _frames_create (VkhPresenter r) {
+	r->frames = (vkh_frame_t*)malloc(r->frameCount * sizeof(vkh_frame_t));
+	for (uint32_t i=0; i<r->frameCount; i++) {
+		r->frames[i].semaAcquired	= vkh_semaphore_create (r->dev);
+		r->frames[i].fence			= vkh_fence_create_signaled (r->dev);
+		r->frames[i].serial			= r->submitSerial;
+	}
+	r->currentFrame = 0;
+}
+static void _frames_destroy (VkhPresenter r) {
+	for (uint32_t i=0; i<r->frameCount; i++) {
+		vkDestroySemaphore	(r->dev->dev, r->frames[i].semaAcquired, NULL);
+		vkDestroyFence		(r->dev->dev, r->frames[i].fence, NULL);
+	}
+	free (r->frames);
+}
+
+/**
+ * @brief the presenter submits and presents through 'presentQueue', so it may be shared with other threads
+ * using the same VkhQueue. The queue has to outlive the presenter.
+ */
+VkhPresenter vkh_presenter_create_with_queue (VkhDevice dev, VkhQueue presentQueue, VkSurfaceKHR surface, uint32_t width, uint32_t height,
 						   VkFormat preferedFormat, VkPresentModeKHR presentMode) {
 	VkhPresenter r = (VkhPresenter)calloc(1,sizeof(vkh_presenter_t));
 
 	r->dev = dev;
-	r->qFam = presentQueueFamIdx ;
+	r->queue = presentQueue;
+	r->qFam = presentQueue->familyIndex;
 	r->surface = surface;
 	r->width = width;
 	r->height = height;
-	vkGetDeviceQueue(r->dev->dev, r->qFam, 0, &r->queue);
 
-	r->cmdPool			= vkh_cmd_pool_create  (r->dev, presentQueueFamIdx, 0);
-	r->semaPresentEnd	= vkh_semaphore_create (r->dev);
-	r->semaDrawEnd		= vkh_semaphore_create (r->dev);
-	r->fenceDraw		= vkh_fence_create_signaled(r->dev);
+	r->cmdPool			= vkh_cmd_pool_create  (r->dev, r->qFam, 0);
+	r->frameCount		= VKH_PRESENTER_FRAMES_IN_FLIGHT;
+	_frames_create (r);
 
-	_init_phy_surface (r, preferedFormat, presentMode);
+	if (surface != VK_NULL_HANDLE) {
+		r->presentLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		_init_phy_surface (r, preferedFormat, presentMode);
+	} else {
+		r->presentLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		r->format = preferedFormat;
+	}
 
 	vkh_presenter_create_swapchain (r);
 
 	return r;
 }
+//present on the first queue of 'presentQueueFamIdx' through a VkhQueue owned by the presenter.
+VkhPresenter vkh_presenter_create (VkhDevice dev, uint32_t presentQueueFamIdx, VkSurfaceKHR surface, uint32_t width, uint32_t height,
+						   VkFormat preferedFormat, VkPresentModeKHR presentMode) {
+	VkhPresenter r = vkh_presenter_create_with_queue (dev, vkh_queue_create (dev, presentQueueFamIdx, 0), surface,
+													  width, height, preferedFormat, presentMode);
+	r->ownsQueue = true;
+	return r;
+}
 
+//vkDeviceWaitIdle would need every queue of the device to be locked.
+static void _wait_idle (VkhPresenter r) {
+	vkh_queue_lock (r->queue);
+	vkQueueWaitIdle (r->queue->queue);
+	vkh_queue_unlock (r->queue);
+}
 void vkh_presenter_destroy (VkhPresenter r) {
-	vkDeviceWaitIdle (r->dev->dev);
+	_wait_idle (r);
 
 	_swapchain_destroy (r);
+	for (uint32_t i=0; i<r->retiredCount; i++)
+		_retired_release (r, &r->retired[i]);
+	free (r->retired);
 
-	vkDestroySemaphore	(r->dev->dev, r->semaDrawEnd, NULL);
-	vkDestroySemaphore	(r->dev->dev, r->semaPresentEnd, NULL);
-	vkDestroyFence		(r->dev->dev, r->fenceDraw, NULL);
+	_frames_destroy (r);
+	if (r->renderPass != VK_NULL_HANDLE)
+		vkDestroyRenderPass (r->dev->dev, r->renderPass, NULL);
 	vkDestroyCommandPool(r->dev->dev, r->cmdPool, NULL);
+	if (r->ownsQueue)
+		vkh_queue_destroy (r->queue);
 
 	free (r);
 }
 
 bool vkh_presenter_acquireNextImage (VkhPresenter r, VkFence fence, VkSemaphore semaphore) {
+	if (r->surface == VK_NULL_HANDLE) {
+		//headless, next ring image, semaphore and fence are signaled by an empty submit
+		r->currentScBufferIndex = r->nextImage;
+		r->nextImage = (r->nextImage + 1) % r->imgCount;
+		if (fence != VK_NULL_HANDLE || semaphore != VK_NULL_HANDLE) {
+			VkSubmitInfo submit_info = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+										 .signalSemaphoreCount = semaphore != VK_NULL_HANDLE ? 1 : 0,
+										 .pSignalSemaphores = &semaphore };
+			VK_CHECK_RESULT(vkh_queue_submit (r->queue, 1, &submit_info, fence));
+		}
+		return true;
+	}
 	// Get the index of the next available swapchain image:
 	VkResult err = vkAcquireNextImageKHR
 			(r->dev->dev, r->swapChain, UINT64_MAX, semaphore, fence, &r->currentScBufferIndex);
 	return ((err != VK_ERROR_OUT_OF_DATE_KHR) && (err != VK_SUBOPTIMAL_KHR));
 }
+//destroy retired swapchains no longer used, presents have no fence so they are kept frameCount more frames.
+static void _retired_collect (VkhPresenter r) {
+	uint32_t kept = 0;
+	for (uint32_t i=0; i<r->retiredCount; i++) {
+		if (r->completedSerial >= r->retired[i].serial + r->frameCount)
+			_retired_release (r, &r->retired[i]);
+		else
+			r->retired[kept++] = r->retired[i];
+	}
+	r->retiredCount = kept;
+}
 
 
+/**
+ * @brief set the number of frames the cpu may record while the gpu still draws the previous ones.
+ * Waits for the present queue to be idle.
+ */
+void vkh_presenter_set_frames_in_flight (VkhPresenter r, uint32_t frameCount) {
+	_wait_idle (r);
+	r->completedSerial = r->submitSerial;
+	_frames_destroy (r);
+	r->frameCount = MAX(frameCount, 1);
+	_frames_create (r);
+	for (uint32_t i=0; i<r->imgCount; i++)
+		r->imageFences[i] = VK_NULL_HANDLE;
+}
+uint32_t vkh_presenter_get_frames_in_flight (VkhPresenter r) {
+	return r->frameCount;
+}
+//index of the frame in flight being recorded, to select per frame resources.
+uint32_t vkh_presenter_get_frame_index (VkhPresenter r) {
+	return r->currentFrame;
+}
+void vkh_presenter_set_max_queued_frames (VkhPresenter r, uint32_t maxQueued) {
+	r->maxQueued = maxQueued;
+}
+//true if present ids are attached and present completions can be waited.
+bool vkh_presenter_present_wait_supported (VkhPresenter r) {
+#ifdef VK_KHR_present_wait
+	return r->dev->WaitForPresentKHR != NULL;
+#else
+	return false;
+#endif
+}
+static void _timings_displayed (VkhPresenter r, uint64_t presentId, uint64_t time) {
+	for (uint64_t id = r->displayedId + 1; id <= presentId; id++) {
+		if (r->presentId - id < VKH_PRESENTER_TIMINGS)
+			r->timings[id % VKH_PRESENTER_TIMINGS].displayTime = time;
+	}
+	r->displayedId = presentId;
+}
+//stamp completed presents without blocking, then block until at most maxQueued presents are pending.
+static void _pace (VkhPresenter r) {
+#ifdef VK_KHR_present_wait
+	if (r->dev->WaitForPresentKHR && r->surface != VK_NULL_HANDLE) {
+		//ids presented to a retired swapchain can't be waited anymore
+		if (r->displayedId + 1 < r->swapchainFirstId)
+			r->displayedId = r->swapchainFirstId - 1;
+		while (r->displayedId < r->presentId &&
+			   r->dev->WaitForPresentKHR (r->dev->dev, r->swapChain, r->displayedId + 1, 0) == VK_SUCCESS)
+			_timings_displayed (r, r->displayedId + 1, vkh_host_time ());
+		if (r->maxQueued > 0 && r->presentId > r->displayedId + r->maxQueued) {
+			uint64_t target = r->presentId - r->maxQueued;
+			if (r->dev->WaitForPresentKHR (r->dev->dev, r->swapChain, target, FENCE_TIMEOUT) == VK_SUCCESS)
+				_timings_displayed (r, target, vkh_host_time ());
+		}
+		return;
+	}
+#endif
+	if (r->maxQueued == 0 || r->submitSerial < r->maxQueued)
+		return;
+	//fallback, wait for the draws older than the last maxQueued ones
+	uint64_t target = r->submitSerial - r->maxQueued + 1;
+	for (uint32_t i=0; i<r->frameCount; i++) {
+		if (r->frames[i].serial > r->completedSerial && r->frames[i].serial <= target) {
+			vkWaitForFences (r->dev->dev, 1, &r->frames[i].fence, VK_TRUE, FENCE_TIMEOUT);
+			r->completedSerial = MAX(r->completedSerial, r->frames[i].serial);
+		}
+	}
+}
+/**
+ * @brief copy the timings of the last frames, oldest first.
+ * @return the number of timings written, at most VKH_PRESENTER_TIMINGS.
+ */
+uint32_t vkh_presenter_get_frame_timings (VkhPresenter r, VkhFrameTiming* timings, uint32_t maxCount) {
+	uint32_t count = (uint32_t)MIN(MIN(r->presentId, VKH_PRESENTER_TIMINGS), maxCount);
+	for (uint32_t i=0; i<count; i++)
+		timings[i] = r->timings[(r->presentId - count + 1 + i) % VKH_PRESENTER_TIMINGS];
+	return count;
+}
+void vkh_presenter_get_pacing_stats (VkhPresenter r, VkhPacingStats* stats) {
+	VkhFrameTiming timings[VKH_PRESENTER_TIMINGS];
+	uint32_t count = vkh_presenter_get_frame_timings (r, timings, VKH_PRESENTER_TIMINGS);
+	*stats = (VkhPacingStats) { .frames = count };
+	if (count == 0)
+		return;
+	double sum = 0, sumSq = 0, latencySum = 0;
+	for (uint32_t i=0; i<count; i++) {
+		uint64_t end = timings[i].displayTime ? timings[i].displayTime : timings[i].presentTime;
+		double latency = (end - timings[i].acquireTime) / 1e6;
+		latencySum += latency;
+		stats->maxLatency = MAX(stats->maxLatency, latency);
+		if (i > 0) {
+			double interval = (timings[i].presentTime - timings[i-1].presentTime) / 1e6;
+			sum += interval;
+			sumSq += interval * interval;
+		}
+	}
+	stats->latency = latencySum / count;
+	if (count > 1) {
+		stats->frameTime = sum / (count - 1);
+		stats->frameTimeJitter = sqrt (MAX(sumSq / (count - 1) - stats->frameTime * stats->frameTime, 0));
+	}
+}
+/**
+ * @brief wait for the oldest frame in flight to complete, acquire the next swapchain image and submit its command
+ * buffer without waiting for the gpu, then present.
+ */
 bool vkh_presenter_draw (VkhPresenter r) {
-	if (!vkh_presenter_acquireNextImage (r, VK_NULL_HANDLE, r->semaPresentEnd)){
+	vkh_frame_t* frame = &r->frames[r->currentFrame];
+	vkWaitForFences	(r->dev->dev, 1, &frame->fence, VK_TRUE, FENCE_TIMEOUT);
+	//a fence also covers the submissions made before on the queue
+	r->completedSerial = MAX(r->completedSerial, frame->serial);
+	if (r->retiredCount > 0)
+		_retired_collect (r);
+	_pace (r);
+	bool headless = r->surface == VK_NULL_HANDLE;
+	if (headless)
+		_frames_deliver (r);
+
+	//a suboptimal image is still drawn and presented, its acquire semaphore is signaled
+	uint64_t acquireTime = vkh_host_time ();
+	VkResult acquired = VK_SUCCESS;
+	if (headless) {
+		r->currentScBufferIndex = r->nextImage;
+		r->nextImage = (r->nextImage + 1) % r->imgCount;
+	} else
+		acquired = vkAcquireNextImageKHR (r->dev->dev, r->swapChain, UINT64_MAX, frame->semaAcquired,
+										  VK_NULL_HANDLE, &r->currentScBufferIndex);
+	if (acquired == VK_ERROR_OUT_OF_DATE_KHR) {
 		vkh_presenter_create_swapchain (r);
 		return false;
 	}
+	uint32_t index = r->currentScBufferIndex;
+	//an older frame may still be drawing to this image if images are acquired out of order
+	VkFence* imageFence = &r->imageFences[index];
+	if (*imageFence != VK_NULL_HANDLE && *imageFence != frame->fence)
+		vkWaitForFences	(r->dev->dev, 1, imageFence, VK_TRUE, FENCE_TIMEOUT);
+	*imageFence = frame->fence;
+	if (headless && r->imagePresentIds[index] != 0) {
+		//the previous frame of this image is done, deliver it before it is overwritten
+		r->completedSerial = MAX(r->completedSerial, r->imageSerials[index]);
+		_frames_deliver (r);
+	}
 
 	VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	VkCommandBuffer cmds[3];
+	uint32_t cmdCount = 0;
+	if (!r->imageUsed[index])
+		cmds[cmdCount++] = r->initCmds[index];
+	cmds[cmdCount++] = r->cmdBuffs[index];
+	if (r->readbackCmds)
+		cmds[cmdCount++] = r->readbackCmds[index];
+	r->imageUsed[index] = true;
 	VkSubmitInfo submit_info = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-								 .commandBufferCount = 1,
-								 .signalSemaphoreCount = 1,
-								 .pSignalSemaphores = &r->semaDrawEnd,
-								 .waitSemaphoreCount = 1,
-								 .pWaitSemaphores = &r->semaPresentEnd,
+								 .commandBufferCount = cmdCount,
+								 .signalSemaphoreCount = headless ? 0 : 1,
+								 .pSignalSemaphores = &r->semaDrawEnd[index],
+								 .waitSemaphoreCount = headless ? 0 : 1,
+								 .pWaitSemaphores = &frame->semaAcquired,
 								 .pWaitDstStageMask = &dstStageMask,
-								 .pCommandBuffers = &r->cmdBuffs[r->currentScBufferIndex]};
-
-	vkWaitForFences	(r->dev->dev, 1, &r->fenceDraw, VK_TRUE, FENCE_TIMEOUT);
-	vkResetFences	(r->dev->dev, 1, &r->fenceDraw);
-
-	VK_CHECK_RESULT(vkQueueSubmit (r->queue, 1, &submit_info, r->fenceDraw));
+								 .pCommandBuffers = cmds};
+
+	vkResetFences	(r->dev->dev, 1, &frame->fence);
+
+	VK_CHECK_RESULT(vkh_queue_submit (r->queue, 1, &submit_info, frame->fence));
+	frame->serial = ++r->submitSerial;
+
+	if (headless) {
+		uint64_t presentId = ++r->presentId;
+		r->timings[presentId % VKH_PRESENTER_TIMINGS] = (VkhFrameTiming) {
+			.presentId		= presentId,
+			.acquireTime	= acquireTime,
+			.presentTime	= vkh_host_time ()
+		};
+		r->imagePresentIds[index]	= presentId;
+		r->imageSerials[index]		= frame->serial;
+		r->currentFrame = (r->currentFrame + 1) % r->frameCount;
+		return true;
+	}
 
 	/* Now present the image in the window */
 	VkPresentInfoKHR present = { .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
 								 .swapchainCount = 1,
 								 .pSwapchains = &r->swapChain,
 								 .waitSemaphoreCount = 1,
-								 .pWaitSemaphores = &r->semaDrawEnd,
+								 .pWaitSemaphores = &r->semaDrawEnd[r->currentScBufferIndex],
 								 .pImageIndices = &r->currentScBufferIndex };
+	uint64_t presentId = ++r->presentId;
+#ifdef VK_KHR_present_wait
+	VkPresentIdKHR presentIdInfo = { .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+									 .swapchainCount = 1,
+									 .pPresentIds = &presentId };
+	if (r->dev->WaitForPresentKHR)
+		present.pNext = &presentIdInfo;
+#endif
+	r->timings[presentId % VKH_PRESENTER_TIMINGS] = (VkhFrameTiming) {
+		.presentId		= presentId,
+		.acquireTime	= acquireTime,
+		.presentTime	= vkh_host_time ()
+	};
 
 	/* Make sure command buffer is finished before presenting */
-	vkQueuePresentKHR(r->queue, &present);
+	vkh_queue_lock (r->queue);
+	VkResult presented = vkQueuePresentKHR(r->queue->queue, &present);
+	vkh_queue_unlock (r->queue);
+	VKH_STAT_ADD(VKH_STAT_PRESENTS, 1);
+	r->currentFrame = (r->currentFrame + 1) % r->frameCount;
+	if (acquired == VK_SUBOPTIMAL_KHR || presented == VK_SUBOPTIMAL_KHR || presented == VK_ERROR_OUT_OF_DATE_KHR) {
+		vkh_presenter_create_swapchain (r);
+		return false;
+	}
 	return true;
 }
 
@@ -153,7 +408,7 @@ void vkh_presenter_build_blit_cmd (VkhPresenter r, VkImage blitSource, uint32_t
 					   1, &cregion);*/
 
 		set_image_layout(cb, bltDstImage, VK_IMAGE_ASPECT_COLOR_BIT,
-						 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+						 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, r->presentLayout,
 						 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
 		set_image_layout(cb, blitSource, VK_IMAGE_ASPECT_COLOR_BIT,
 				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
@@ -166,6 +421,197 @@ void vkh_presenter_get_size (VkhPresenter r, uint32_t* pWidth, uint32_t* pHeight
 	*pWidth = r->width;
 	*pHeight = r->height;
 }
+//headless presenters have no surface extent to follow, the image ring is created again with the new size.
+void vkh_presenter_resize (VkhPresenter r, uint32_t width, uint32_t height) {
+	r->width	= width;
+	r->height	= height;
+	vkh_presenter_create_swapchain (r);
+}
+//layout the presenter command buffers must leave the images in.
+VkImageLayout vkh_presenter_get_present_layout (VkhPresenter r) {
+	return r->presentLayout;
+}
+//hand finished headless frames to 'func' in order, from the thread calling vkh_presenter_draw.
+static void _frames_deliver (VkhPresenter r) {
+	while (true) {
+		uint32_t next = UINT32_MAX;
+		for (uint32_t i=0; i<r->imgCount; i++) {
+			if (r->imagePresentIds[i] != 0 && (next == UINT32_MAX || r->imagePresentIds[i] < r->imagePresentIds[next]))
+				next = i;
+		}
+		if (next == UINT32_MAX || r->imageSerials[next] > r->completedSerial)
+			return;
+		uint64_t id = r->imagePresentIds[next];
+		r->imagePresentIds[next] = 0;
+		if (r->presentId - id < VKH_PRESENTER_TIMINGS)
+			r->timings[id % VKH_PRESENTER_TIMINGS].displayTime = vkh_host_time ();
+		if (r->frameFunc == NULL)
+			continue;
+		const void* pixels = NULL;
+		if (r->readbackBuffs) {
+			vkh_buffer_invalidate (r->readbackBuffs[next]);
+			pixels = vkh_buffer_get_mapped_pointer (r->readbackBuffs[next]);
+		}
+		r->frameFunc (r->frameUserData, id, r->ScBuffers[next], pixels);
+	}
+}
+/**
+ * @brief wait for the frames in flight, and deliver the headless ones to the frame callback.
+ */
+void vkh_presenter_flush_frames (VkhPresenter r) {
+	for (uint32_t i=0; i<r->frameCount; i++) {
+		if (r->frames[i].serial > r->completedSerial)
+			vkWaitForFences (r->dev->dev, 1, &r->frames[i].fence, VK_TRUE, FENCE_TIMEOUT);
+	}
+	r->completedSerial = r->submitSerial;
+	if (r->surface == VK_NULL_HANDLE && r->imagePresentIds)
+		_frames_deliver (r);
+}
+/**
+ * @brief set the callback receiving headless frames once rendered, in order, from vkh_presenter_draw or
+ * vkh_presenter_flush_frames.
+ * @param readbackTexelSize if not 0, images are copied to host visible buffers after each draw and 'pixels' gives
+ * the tightly packed texels, valid until the callback returns.
+ */
+void vkh_presenter_set_frame_callback (VkhPresenter r, VkhFrameFunc func, void* userData, uint32_t readbackTexelSize) {
+	vkh_presenter_flush_frames (r);
+	r->frameFunc			= func;
+	r->frameUserData		= userData;
+	if (r->readbackBuffs) {
+		for (uint32_t i=0; i<r->imgCount; i++) {
+			vkh_buffer_destroy_force (r->readbackBuffs[i]);
+			vkFreeCommandBuffers (r->dev->dev, r->cmdPool, 1, &r->readbackCmds[i]);
+		}
+		free (r->readbackBuffs);
+		free (r->readbackCmds);
+		r->readbackBuffs	= NULL;
+		r->readbackCmds		= NULL;
+	}
+	r->readbackTexelSize	= r->surface == VK_NULL_HANDLE ? readbackTexelSize : 0;
+	_readback_create (r);
+}
+uint32_t vkh_presenter_get_image_count (VkhPresenter r) {
+	return r->imgCount;
+}
+VkhImage vkh_presenter_get_image (VkhPresenter r, uint32_t index) {
+	return r->ScBuffers[index];
+}
+/**
+ * @brief command buffer submitted by vkh_presenter_draw when the swapchain image 'index' is acquired.
+ * Record it again each time vkh_presenter_draw returns false, the swapchain having been recreated.
+ */
+VkCommandBuffer vkh_presenter_get_cmd_buffer (VkhPresenter r, uint32_t index) {
+	return r->cmdBuffs[index];
+}
+/**
+ * @brief create a render pass with the swapchain image as single color attachment, left in present layout,
+ * and a framebuffer per swapchain image, recreated with the swapchain. Rendering straight to the swapchain
+ * saves the offscreen image blit.
+ * @param loadOp VK_ATTACHMENT_LOAD_OP_LOAD keeps the previous content of the image, images start from the present
+ * layout because vkh_presenter_draw transitions them from undefined before their first draw.
+ */
+void vkh_presenter_create_render_pass (VkhPresenter r, VkAttachmentLoadOp loadOp) {
+	VkAttachmentDescription attachment = { .format = r->format,
+										   .samples = VK_SAMPLE_COUNT_1_BIT,
+										   .loadOp = loadOp,
+										   .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+										   .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+										   .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+										   .initialLayout = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ?
+												r->presentLayout : VK_IMAGE_LAYOUT_UNDEFINED,
+										   .finalLayout = r->presentLayout };
+	VkAttachmentReference colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	VkSubpassDescription subpass = { .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+									 .colorAttachmentCount = 1,
+									 .pColorAttachments = &colorRef };
+	//the acquire semaphore is waited at color attachment output, transition must wait for it too.
+	VkSubpassDependency dependency = { .srcSubpass = VK_SUBPASS_EXTERNAL,
+									   .dstSubpass = 0,
+									   .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+									   .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+									   .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT };
+	VkRenderPassCreateInfo info = { .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+									.attachmentCount = 1,
+									.pAttachments = &attachment,
+									.subpassCount = 1,
+									.pSubpasses = &subpass,
+									.dependencyCount = 1,
+									.pDependencies = &dependency };
+	if (r->renderPass != VK_NULL_HANDLE) {
+		_wait_idle (r);
+		for (uint32_t i=0; i<r->imgCount; i++)
+			vkDestroyFramebuffer (r->dev->dev, r->frameBuffs[i], NULL);
+		free (r->frameBuffs);
+		vkDestroyRenderPass (r->dev->dev, r->renderPass, NULL);
+	}
+	VK_CHECK_RESULT(vkCreateRenderPass (r->dev->dev, &info, NULL, &r->renderPass));
+	_framebuffers_create (r);
+}
+VkRenderPass vkh_presenter_get_render_pass (VkhPresenter r) {
+	return r->renderPass;
+}
+VkFramebuffer vkh_presenter_get_framebuffer (VkhPresenter r, uint32_t index) {
+	return r->frameBuffs[index];
+}
+//begin the presenter render pass on the swapchain image 'index' with its full extent.
+void vkh_presenter_cmd_begin_render_pass (VkhPresenter r, VkCommandBuffer cmd, uint32_t index, const VkClearValue* clearValue) {
+	VkRenderPassBeginInfo info = { .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+								   .renderPass = r->renderPass,
+								   .framebuffer = r->frameBuffs[index],
+								   .renderArea = {{0, 0}, {r->width, r->height}},
+								   .clearValueCount = clearValue ? 1 : 0,
+								   .pClearValues = clearValue };
+	vkCmdBeginRenderPass (cmd, &info, VK_SUBPASS_CONTENTS_INLINE);
+}
+#ifdef VK_VERSION_1_3
+/**
+ * @brief dynamic rendering to the swapchain image 'index', the image is transitioned to color attachment layout
+ * before and to present layout by @ref vkh_presenter_cmd_end_rendering. Requires the dynamicRendering feature.
+ */
+void vkh_presenter_cmd_begin_rendering (VkhPresenter r, VkCommandBuffer cmd, uint32_t index, VkAttachmentLoadOp loadOp,
+										const VkClearValue* clearValue) {
+	VkhImage img = r->ScBuffers[index];
+	VkImageMemoryBarrier barrier = { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+									 .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+									 .oldLayout = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ?
+										r->presentLayout : VK_IMAGE_LAYOUT_UNDEFINED,
+									 .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+									 .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+									 .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+									 .image = img->image,
+									 .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+	vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+						  0, 0, NULL, 0, NULL, 1, &barrier);
+	VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
+	VkRenderingAttachmentInfo colorAttachment = { .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+												  .imageView = img->view,
+												  .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+												  .loadOp = loadOp,
+												  .storeOp = VK_ATTACHMENT_STORE_OP_STORE };
+	if (clearValue)
+		colorAttachment.clearValue = *clearValue;
+	VkRenderingInfo info = { .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+							 .renderArea = {{0, 0}, {r->width, r->height}},
+							 .layerCount = 1,
+							 .colorAttachmentCount = 1,
+							 .pColorAttachments = &colorAttachment };
+	vkCmdBeginRendering (cmd, &info);
+}
+void vkh_presenter_cmd_end_rendering (VkhPresenter r, VkCommandBuffer cmd, uint32_t index) {
+	vkCmdEndRendering (cmd);
+	VkImageMemoryBarrier barrier = { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+									 .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+									 .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+									 .newLayout = r->presentLayout,
+									 .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+									 .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+									 .image = r->ScBuffers[index]->image,
+									 .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+	vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+						  0, 0, NULL, 0, NULL, 1, &barrier);
+	VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
+}
+#endif
 void _init_phy_surface(VkhPresenter r, VkFormat preferedFormat, VkPresentModeKHR presentMode){
 	uint32_t count;
 	VK_CHECK_RESULT(vkGetPhysicalDeviceSurfaceFormatsKHR (r->dev->phy, r->surface, &count, NULL));
@@ -200,10 +646,7 @@ void _init_phy_surface(VkhPresenter r, VkFormat preferedFormat, VkPresentModeKHR
 	free(presentModes);
 }
 
-void vkh_presenter_create_swapchain (VkhPresenter r){
-	// Ensure all operations on the device have been finished before destroying resources
-	vkDeviceWaitIdle(r->dev->dev);
-
+static void _swapchain_create (VkhPresenter r){
 	VkSurfaceCapabilitiesKHR surfCapabilities;
 	VK_CHECK_RESULT(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(r->dev->phy, r->surface, &surfCapabilities));
 	assert (surfCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
@@ -243,9 +686,10 @@ void vkh_presenter_create_swapchain (VkhPresenter r){
 											.oldSwapchain = r->swapChain};
 
 	VK_CHECK_RESULT(vkCreateSwapchainKHR (r->dev->dev, &createInfo, NULL, &newSwapchain));
-	if (r->swapChain != VK_NULL_HANDLE)
-		_swapchain_destroy(r);
+	if (r->ScBuffers != NULL)
+		_swapchain_retire(r);
 	r->swapChain = newSwapchain;
+	r->swapchainFirstId = r->presentId + 1;
 
 	VK_CHECK_RESULT(vkGetSwapchainImagesKHR(r->dev->dev, r->swapChain, &r->imgCount, NULL));
 	assert (r->imgCount>0);
@@ -254,27 +698,214 @@ void vkh_presenter_create_swapchain (VkhPresenter r){
 	VK_CHECK_RESULT(vkGetSwapchainImagesKHR(r->dev->dev, r->swapChain, &r->imgCount, images));
 
 	r->ScBuffers = (VkhImage*)		malloc (r->imgCount * sizeof(VkhImage));
-	r->cmdBuffs = (VkCommandBuffer*)malloc (r->imgCount * sizeof(VkCommandBuffer));
+	r->semaDrawEnd = (VkSemaphore*)	malloc (r->imgCount * sizeof(VkSemaphore));
 
 	for (uint32_t i=0; i<r->imgCount; i++) {
 
 		VkhImage sci = vkh_image_import(r->dev, images[i], r->format, r->width, r->height);
 		vkh_image_create_view(sci, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
 		r->ScBuffers [i] = sci;
-
+		r->semaDrawEnd [i] = vkh_semaphore_create (r->dev);
+	}
+	free (images);
+}
+//ring of offscreen images standing for the swapchain without surface.
+static void _headless_create (VkhPresenter r){
+	//pending frames belong to the images being retired
+	vkh_presenter_flush_frames (r);
+	if (r->ScBuffers != NULL)
+		_swapchain_retire(r);
+	r->imgCount = VKH_PRESENTER_HEADLESS_IMAGES;
+	r->ScBuffers = (VkhImage*)malloc (r->imgCount * sizeof(VkhImage));
+	for (uint32_t i=0; i<r->imgCount; i++) {
+		r->ScBuffers [i] = vkh_image_create (r->dev, r->format, r->width, r->height, VK_IMAGE_TILING_OPTIMAL, VKH_MEMORY_USAGE_GPU_ONLY,
+											 VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+											 VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+		vkh_image_create_view(r->ScBuffers [i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+	r->nextImage = 0;
+}
+/**
+ * @brief create a swapchain matching the current surface size. The previous one is given as oldSwapchain and
+ * retired, its images and command buffers are destroyed once the draws using them have completed, without
+ * waiting for the device to be idle. Blit command buffers have to be built again.
+ * Without surface, the headless image ring is created again with the presenter size.
+ */
+void vkh_presenter_create_swapchain (VkhPresenter r){
+	if (r->surface == VK_NULL_HANDLE)
+		_headless_create (r);
+	else
+		_swapchain_create (r);
+
+	r->cmdBuffs			= (VkCommandBuffer*)malloc (r->imgCount * sizeof(VkCommandBuffer));
+	r->imageFences		= (VkFence*)		calloc (r->imgCount, sizeof(VkFence));
+	r->imagePresentIds	= (uint64_t*)		calloc (r->imgCount, sizeof(uint64_t));
+	r->imageSerials		= (uint64_t*)		calloc (r->imgCount, sizeof(uint64_t));
+	r->imageUsed		= (bool*)			calloc (r->imgCount, sizeof(bool));
+	r->initCmds			= (VkCommandBuffer*)malloc (r->imgCount * sizeof(VkCommandBuffer));
+	for (uint32_t i=0; i<r->imgCount; i++) {
 		r->cmdBuffs [i] = vkh_cmd_buff_create(r->dev, r->cmdPool,VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		r->initCmds [i] = vkh_cmd_buff_create(r->dev, r->cmdPool,VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		vkh_cmd_begin (r->initCmds[i], 0);
+		_cmd_init_barrier (r, r->initCmds[i], i);
+		vkh_cmd_end (r->initCmds[i]);
 	}
 	r->currentScBufferIndex = 0;
-	free (images);
+	if (r->renderPass != VK_NULL_HANDLE)
+		_framebuffers_create (r);
+	_readback_create (r);
 }
-void _swapchain_destroy (VkhPresenter r){
-	for (uint32_t i = 0; i < r->imgCount; i++)
+//new images are undefined, present layout is the starting layout of the draw command buffers.
+static void _cmd_init_barrier (VkhPresenter r, VkCommandBuffer cmd, uint32_t index) {
+	VkImageMemoryBarrier barrier = { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+									 .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+									 .newLayout = r->presentLayout,
+									 .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+									 .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+									 .image = r->ScBuffers[index]->image,
+									 .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+	//source stage matches the acquire semaphore wait
+	vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+						  0, 0, NULL, 0, NULL, 1, &barrier);
+	VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
+}
+/**
+ * @brief for command buffers submitted without vkh_presenter_draw: record the transition of image 'index' from the
+ * undefined layout it is created in to the present layout if this is its first use since the swapchain creation.
+ */
+void vkh_presenter_cmd_init_image (VkhPresenter r, VkCommandBuffer cmd, uint32_t index) {
+	if (r->imageUsed[index])
+		return;
+	_cmd_init_barrier (r, cmd, index);
+	r->imageUsed[index] = true;
+}
+//per image copy to a host visible buffer, recorded once and submitted after each draw.
+static void _readback_create (VkhPresenter r) {
+	if (r->readbackTexelSize == 0)
+		return;
+	VkDeviceSize size = (VkDeviceSize)r->width * r->height * r->readbackTexelSize;
+	r->readbackBuffs	= (VkhBuffer*)		malloc (r->imgCount * sizeof(VkhBuffer));
+	r->readbackCmds		= (VkCommandBuffer*)malloc (r->imgCount * sizeof(VkCommandBuffer));
+	for (uint32_t i=0; i<r->imgCount; i++) {
+		r->readbackBuffs[i] = vkh_buffer_create (r->dev, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VKH_MEMORY_USAGE_GPU_TO_CPU, size);
+		vkh_buffer_map (r->readbackBuffs[i]);
+		VkCommandBuffer cmd = r->readbackCmds[i] = vkh_cmd_buff_create (r->dev, r->cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		vkh_cmd_begin (cmd, 0);
+		//images are already in transfer source layout, only the draw writes have to be made available
+		VkImageMemoryBarrier imgBarrier = { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+											.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+											.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+											.oldLayout = r->presentLayout,
+											.newLayout = r->presentLayout,
+											.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+											.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+											.image = r->ScBuffers[i]->image,
+											.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+		vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &imgBarrier);
+		VkBufferImageCopy region = { .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+									 .imageExtent = {r->width, r->height, 1} };
+		vkCmdCopyImageToBuffer (cmd, r->ScBuffers[i]->image, r->presentLayout, vkh_buffer_get_vkbuffer (r->readbackBuffs[i]), 1, &region);
+		VkBufferMemoryBarrier buffBarrier = { .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+											  .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+											  .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+											  .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+											  .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+											  .buffer = vkh_buffer_get_vkbuffer (r->readbackBuffs[i]),
+											  .size = VK_WHOLE_SIZE };
+		vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &buffBarrier, 0, NULL);
+		VKH_STAT_ADD(VKH_STAT_BARRIERS, 2);
+		vkh_cmd_end (cmd);
+	}
+}
+static void _framebuffers_create (VkhPresenter r) {
+	r->frameBuffs = (VkFramebuffer*)malloc (r->imgCount * sizeof(VkFramebuffer));
+	for (uint32_t i=0; i<r->imgCount; i++) {
+		VkFramebufferCreateInfo info = { .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+										 .renderPass = r->renderPass,
+										 .attachmentCount = 1,
+										 .pAttachments = &r->ScBuffers[i]->view,
+										 .width = r->width,
+										 .height = r->height,
+										 .layers = 1 };
+		VK_CHECK_RESULT(vkCreateFramebuffer (r->dev->dev, &info, NULL, &r->frameBuffs[i]));
+	}
+}
+static void _retired_release (VkhPresenter r, vkh_retired_swapchain_t* sc) {
+	for (uint32_t i = 0; i < sc->imgCount; i++)
 	{
-		vkh_image_destroy (r->ScBuffers [i]);
-		vkFreeCommandBuffers (r->dev->dev, r->cmdPool, 1, &r->cmdBuffs[i]);
+		vkh_image_destroy_force (sc->ScBuffers [i]);
+		vkFreeCommandBuffers (r->dev->dev, r->cmdPool, 1, &sc->cmdBuffs[i]);
+		vkFreeCommandBuffers (r->dev->dev, r->cmdPool, 1, &sc->initCmds[i]);
+		if (sc->semaDrawEnd)
+			vkDestroySemaphore (r->dev->dev, sc->semaDrawEnd[i], NULL);
+		if (sc->frameBuffs)
+			vkDestroyFramebuffer (r->dev->dev, sc->frameBuffs[i], NULL);
+		if (sc->readbackBuffs) {
+			vkh_buffer_destroy_force (sc->readbackBuffs[i]);
+			vkFreeCommandBuffers (r->dev->dev, r->cmdPool, 1, &sc->readbackCmds[i]);
+		}
 	}
-	vkDestroySwapchainKHR (r->dev->dev, r->swapChain, NULL);
+	if (sc->swapChain != VK_NULL_HANDLE)
+		vkDestroySwapchainKHR (r->dev->dev, sc->swapChain, NULL);
+	free(sc->ScBuffers);
+	free(sc->frameBuffs);
+	free(sc->cmdBuffs);
+	free(sc->initCmds);
+	free(sc->semaDrawEnd);
+	free(sc->readbackBuffs);
+	free(sc->readbackCmds);
+}
+//forget the current swapchain resources, owned by a retired entry or released.
+static void _current_reset (VkhPresenter r) {
+	free(r->imageFences);
+	free(r->imagePresentIds);
+	free(r->imageSerials);
+	free(r->imageUsed);
+	r->imageFences		= NULL;
+	r->imageUsed		= NULL;
+	r->initCmds			= NULL;
+	r->imagePresentIds	= NULL;
+	r->imageSerials		= NULL;
+	r->ScBuffers		= NULL;
+	r->frameBuffs		= NULL;
+	r->semaDrawEnd		= NULL;
+	r->readbackBuffs	= NULL;
+	r->readbackCmds		= NULL;
+}
+//move the current swapchain resources to the retired list.
+void _swapchain_retire (VkhPresenter r){
+	if (r->retiredCount == r->retiredReserved) {
+		r->retiredReserved = r->retiredReserved ? r->retiredReserved * 2 : 2;
+		r->retired = (vkh_retired_swapchain_t*)realloc(r->retired, r->retiredReserved * sizeof(vkh_retired_swapchain_t));
+	}
+	r->retired[r->retiredCount++] = (vkh_retired_swapchain_t) {
+		.swapChain	= r->swapChain,
+		.imgCount	= r->imgCount,
+		.ScBuffers	= r->ScBuffers,
+		.cmdBuffs	= r->cmdBuffs,
+		.initCmds	= r->initCmds,
+		.frameBuffs	= r->frameBuffs,
+		.semaDrawEnd= r->semaDrawEnd,
+		.readbackBuffs	= r->readbackBuffs,
+		.readbackCmds	= r->readbackCmds,
+		.serial		= r->submitSerial
+	};
+	r->swapChain = VK_NULL_HANDLE;
+	_current_reset (r);
+}
+void _swapchain_destroy (VkhPresenter r){
+	vkh_retired_swapchain_t sc = {
+		.swapChain	= r->swapChain,
+		.imgCount	= r->imgCount,
+		.ScBuffers	= r->ScBuffers,
+		.cmdBuffs	= r->cmdBuffs,
+		.initCmds	= r->initCmds,
+		.frameBuffs	= r->frameBuffs,
+		.semaDrawEnd= r->semaDrawEnd,
+		.readbackBuffs	= r->readbackBuffs,
+		.readbackCmds	= r->readbackCmds
+	};
+	_retired_release (r, &sc);
 	r->swapChain = VK_NULL_HANDLE;
-	free(r->ScBuffers);
-	free(r->cmdBuffs);
+	_current_reset (r);
 }
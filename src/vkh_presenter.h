@@ -28,17 +28,47 @@ extern "C" {
 
 #include "vkh.h"
 
+#define VKH_PRESENTER_FRAMES_IN_FLIGHT	2	//default frame count recorded by the cpu while the gpu draws
+#define VKH_PRESENTER_TIMINGS			64	//frame timings kept for pacing statistics
+#define VKH_PRESENTER_HEADLESS_IMAGES	3	//offscreen image ring size without surface
+
+//synchronization of one frame in flight.
+typedef struct {
+	VkSemaphore		semaAcquired;//swapchain image acquisition, waited by the draw submit
+	VkFence			fence;//signaled when the draw submit of the frame completes
+	uint64_t		serial;//draw submitted with the fence
+}vkh_frame_t;
+
+//swapchain replaced by a recreation, destroyed once the gpu is done with it.
+typedef struct {
+	VkSwapchainKHR	swapChain;
+	uint32_t		imgCount;
+	VkhImage*		ScBuffers;
+	VkCommandBuffer* cmdBuffs;
+	VkCommandBuffer* initCmds;
+	VkFramebuffer*	frameBuffs;
+	VkSemaphore*	semaDrawEnd;
+	VkhBuffer*		readbackBuffs;
+	VkCommandBuffer* readbackCmds;
+	uint64_t		serial;//last draw submitted to the swapchain
+}vkh_retired_swapchain_t;
+
 typedef struct _vkh_presenter_t {
-	VkQueue			queue;
+	VkhQueue		queue;//locked for present and idle waits
+	bool			ownsQueue;//created by vkh_presenter_create, else owned by the application
 	VkCommandPool	cmdPool;
 	uint32_t		qFam;
 	VkhDevice		dev;
 
-	VkSurfaceKHR	surface;
+	VkSurfaceKHR	surface;//null for headless rendering
+	VkImageLayout	presentLayout;//layout of finished images, transfer source when headless
+	uint32_t		nextImage;//headless ring position
 
-	VkSemaphore		semaPresentEnd;
-	VkSemaphore		semaDrawEnd;
-	VkFence			fenceDraw;
+	uint32_t		frameCount;
+	uint32_t		currentFrame;
+	vkh_frame_t*	frames;
+	uint64_t		submitSerial;//draws submitted
+	uint64_t		completedSerial;//draws known as completed
 
 	VkFormat		format;
 	VkColorSpaceKHR colorSpace;
@@ -49,11 +79,30 @@ typedef struct _vkh_presenter_t {
 	uint32_t		imgCount;
 	uint32_t		currentScBufferIndex;
 
-	VkRenderPass	renderPass;
+	VkRenderPass	renderPass;//direct rendering to swapchain images, frameBuffs are created with it
 	VkSwapchainKHR	swapChain;
 	VkhImage*		ScBuffers;
 	VkCommandBuffer* cmdBuffs;
 	VkFramebuffer*	frameBuffs;
+	VkSemaphore*	semaDrawEnd;//per swapchain image, a presented semaphore is reusable once its image is acquired again
+	VkFence*		imageFences;//fence of the last frame drawing to each swapchain image, null if none
+	bool*			imageUsed;//image left the undefined layout it is created in
+	VkCommandBuffer* initCmds;//transition of the image from undefined to present layout, submitted before its first draw
+	uint32_t		maxQueued;//pending presents limit, 0 for none
+	uint64_t		presentId;//last present id, ids start at 1
+	uint64_t		displayedId;//last present id known as displayed
+	uint64_t		swapchainFirstId;//first present id of the current swapchain
+	VkhFrameTiming	timings[VKH_PRESENTER_TIMINGS];//indexed by present id
+	VkhFrameFunc	frameFunc;
+	void*			frameUserData;
+	uint32_t		readbackTexelSize;//0 if frames are not read back
+	VkhBuffer*		readbackBuffs;//per image, headless only
+	VkCommandBuffer* readbackCmds;//copy of the image to its readback buffer, submitted after the draw
+	uint64_t*		imagePresentIds;//headless frame rendered to each image and not yet delivered, 0 if none
+	uint64_t*		imageSerials;//draw serial of that frame
+	vkh_retired_swapchain_t* retired;
+	uint32_t		retiredCount;
+	uint32_t		retiredReserved;
 }vkh_presenter_t;
 
 #ifdef __cplusplus
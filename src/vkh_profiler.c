@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vkh_profiler.h"
+#include "vkh_device.h"
+
+#ifndef MIN
+# define MIN(a,b) (((a) < (b)) ? (a) : (b))
+#endif
+
+/**
+ * @brief create a GPU profiler writing timestamps around the regions opened with vkh_device_cmd_label_start and
+ * closed with vkh_device_cmd_label_end. Results are read back without waiting once the GPU has reached them.
+ * The profiler is attached to 'dev', replacing the previous one, and must not be destroyed while labeled command
+ * buffers are being recorded.
+ * @param qFamIndex family of the queues the labeled command buffers are submitted to, for timestamp valid bits.
+ * @return NULL if this family does not support timestamps.
+ * @param frameCount number of frames in flight, query pools are reused after this many frames.
+ * @param maxRegions maximum labeled regions per frame, regions beyond are ignored.
+ */
+VkhProfiler vkh_profiler_create (VkhDevice dev, uint32_t qFamIndex, uint32_t frameCount, uint32_t maxRegions) {
+	uint32_t famCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties (dev->phy, &famCount, NULL);
+	VkQueueFamilyProperties* fams = (VkQueueFamilyProperties*)malloc(famCount * sizeof(VkQueueFamilyProperties));
+	vkGetPhysicalDeviceQueueFamilyProperties (dev->phy, &famCount, fams);
+	uint32_t validBits = qFamIndex < famCount ? fams[qFamIndex].timestampValidBits : 0;
+	free (fams);
+	if (validBits == 0) {
+		fprintf (stderr, "vkh_profiler_create: queue family %u does not support timestamps\n", qFamIndex);
+		return NULL;
+	}
+
+	VkhProfiler prof = (VkhProfiler)calloc(1, sizeof(vkh_profiler_t));
+	prof->dev			= dev;
+	prof->frameCount	= frameCount;
+	prof->maxRegions	= maxRegions;
+	prof->tickMask		= validBits >= 64 ? UINT64_MAX : ((uint64_t)1 << validBits) - 1;
+	mtx_init (&prof->mutex, mtx_plain);
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties (dev->phy, &props);
+	prof->period = props.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo infos = { .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+									.queryType = VK_QUERY_TYPE_TIMESTAMP,
+									.queryCount = maxRegions * 2 };
+	prof->frames = (vkh_profiler_frame_t*)calloc(frameCount, sizeof(vkh_profiler_frame_t));
+	for (uint32_t i=0; i<frameCount; i++) {
+		VK_CHECK_RESULT(vkCreateQueryPool (dev->dev, &infos, NULL, &prof->frames[i].pool));
+		prof->frames[i].marks = (vkh_profiler_mark_t*)malloc(maxRegions * sizeof(vkh_profiler_mark_t));
+	}
+	prof->queryData	= (uint64_t*)malloc(maxRegions * 4 * sizeof(uint64_t));
+	prof->results	= (VkhGpuRegion*)malloc(maxRegions * sizeof(VkhGpuRegion));
+
+	vkh_atomic_ptr_store_explicit (&dev->profiler, prof, vkh_memory_order_release);
+	return prof;
+}
+void vkh_profiler_destroy (VkhProfiler prof) {
+	if (prof == NULL)
+		return;
+	//detach only if no other profiler replaced it
+	VkhProfiler attached = prof;
+	while (!vkh_atomic_ptr_compare_exchange_weak (&prof->dev->profiler, &attached, NULL) && attached == prof);
+	for (uint32_t i=0; i<prof->frameCount; i++) {
+		vkDestroyQueryPool (prof->dev->dev, prof->frames[i].pool, NULL);
+		free (prof->frames[i].marks);
+		free (prof->frames[i].submits);
+	}
+	mtx_destroy (&prof->mutex);
+	free (prof->frames);
+	free (prof->stacks);
+	free (prof->queryData);
+	free (prof->results);
+	free (prof->submitResults);
+	free (prof->trace);
+	free (prof->traceFrames);
+	free (prof);
+}
+
+static vkh_profiler_stack_t* _find_stack (VkhProfiler prof, VkCommandBuffer cmd) {
+	for (uint32_t i=0; i<prof->stackCount; i++) {
+		if (prof->stacks[i].cmd == cmd)
+			return &prof->stacks[i];
+	}
+	return NULL;
+}
+static void _append_trace (VkhProfiler prof, const VkhGpuRegion* region, uint64_t frameIndex) {
+	if (prof->traceCount == prof->traceReserved) {
+		prof->traceReserved = prof->traceReserved ? prof->traceReserved * 2 : VKH_PROFILER_INIT_SIZE;
+		prof->trace = (VkhGpuRegion*)realloc(prof->trace, prof->traceReserved * sizeof(VkhGpuRegion));
+		prof->traceFrames = (uint64_t*)realloc(prof->traceFrames, prof->traceReserved * sizeof(uint64_t));
+	}
+	prof->trace[prof->traceCount] = *region;
+	prof->traceFrames[prof->traceCount++] = frameIndex;
+}
+static void _add_submit_region (VkhGpuSubmit* s, uint64_t begin, uint64_t end) {
+	if (s->regionCount == 0 || begin < s->gpuStart)
+		s->gpuStart = begin;
+	if (s->regionCount == 0 || end > s->gpuEnd)
+		s->gpuEnd = end;
+	s->regionCount++;
+}
+//idle gaps between submissions of the same queue, then ticks to host time.
+static void _finish_submits (VkhProfiler prof, vkh_profiler_frame_t* frame) {
+	VkhGpuSubmit* subs = prof->submitResults;
+	for (uint32_t i=0; i<prof->submitResultCount; i++) {
+		if (subs[i].regionCount == 0)
+			continue;
+		bool found = false;
+		uint64_t prevEnd = 0;
+		for (uint32_t j=0; j<prof->submitResultCount; j++) {
+			if (j == i || subs[j].regionCount == 0 || frame->submits[j].queue != frame->submits[i].queue ||
+					subs[j].gpuStart >= subs[i].gpuStart)
+				continue;
+			if (!found || subs[j].gpuEnd > prevEnd)
+				prevEnd = subs[j].gpuEnd;
+			found = true;
+		}
+		if (found && subs[i].gpuStart > prevEnd)
+			subs[i].idleBefore = (double)(subs[i].gpuStart - prevEnd) * prof->period / 1000000.0;
+	}
+	for (uint32_t i=0; i<prof->submitResultCount; i++) {
+		VkhGpuSubmit* s = &subs[i];
+		if (s->regionCount == 0 || !prof->dev->calibrated) {
+			s->gpuStart = s->gpuEnd = 0;
+			continue;
+		}
+		s->gpuStart	= vkh_device_gpu_to_host_time (prof->dev, (s->gpuStart + prof->baseTick) & prof->tickMask);
+		s->gpuEnd	= vkh_device_gpu_to_host_time (prof->dev, (s->gpuEnd + prof->baseTick) & prof->tickMask);
+		s->latency	= ((double)s->gpuStart - (double)s->submitTime) / 1000000.0;
+	}
+}
+/**
+ * @brief read back the timestamps of a recorded frame, without blocking unless 'wait' is set.
+ * Returns false if some closed region has not been reached yet by the GPU.
+ */
+static bool _resolve (VkhProfiler prof, vkh_profiler_frame_t* frame, bool wait) {
+	VkDevice dev = prof->dev->dev;
+	VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+	uint32_t queryCount = frame->markCount * 2;
+	VkResult res = vkGetQueryPoolResults (dev, frame->pool, 0, queryCount, queryCount * 2 * sizeof(uint64_t),
+										  prof->queryData, 2 * sizeof(uint64_t), flags);
+	if (res != VK_SUCCESS && res != VK_NOT_READY) {
+		frame->pending = false;
+		return true;
+	}
+	//regions never closed have no end timestamp and are skipped
+	for (uint32_t i=0; i<frame->markCount; i++) {
+		vkh_profiler_mark_t* m = &frame->marks[i];
+		uint64_t* data = &prof->queryData[m->query * 2];
+		if (!m->closed || (data[1] && data[3]))
+			continue;
+		if (!wait)
+			return false;
+		VK_CHECK_RESULT(vkGetQueryPoolResults (dev, frame->pool, m->query, 2, 4 * sizeof(uint64_t), data,
+											   2 * sizeof(uint64_t), flags | VK_QUERY_RESULT_WAIT_BIT));
+	}
+	frame->pending = false;
+	//a frame older than the current results may complete later on another queue
+	if (prof->resultCount > 0 && frame->frameIndex < prof->resultFrame)
+		return true;
+
+	prof->resultCount = 0;
+	prof->resultFrame = frame->frameIndex;
+	if (frame->submitCount > prof->submitResultReserved) {
+		prof->submitResultReserved = frame->submitCount;
+		prof->submitResults = (VkhGpuSubmit*)realloc(prof->submitResults, frame->submitCount * sizeof(VkhGpuSubmit));
+	}
+	prof->submitResultCount = frame->submitCount;
+	//gpu start and end are first kept in ticks from baseTick
+	for (uint32_t i=0; i<frame->submitCount; i++)
+		prof->submitResults[i] = (VkhGpuSubmit) { .submitTime = frame->submits[i].hostTime };
+	for (uint32_t i=0; i<frame->markCount; i++) {
+		vkh_profiler_mark_t* m = &frame->marks[i];
+		m->result = PROFILER_NONE;
+		if (!m->closed)
+			continue;
+		uint64_t begin = prof->queryData[m->query * 2] & prof->tickMask;
+		uint64_t end = prof->queryData[m->query * 2 + 2] & prof->tickMask;
+		if (!prof->baseSet) {
+			prof->baseTick = begin;
+			prof->baseSet = true;
+		}
+		VkhGpuRegion* r = &prof->results[prof->resultCount];
+		memcpy (r->name, m->name, VKH_PROFILER_NAME_SIZE);
+		r->depth	= m->depth;
+		r->parent	= m->parent == PROFILER_NONE ? PROFILER_NONE : frame->marks[m->parent].result;
+		r->start	= (double)((begin - prof->baseTick) & prof->tickMask) * prof->period / 1000000.0;
+		r->duration	= (double)((end - begin) & prof->tickMask) * prof->period / 1000000.0;
+		r->hostTime	= prof->dev->calibrated ? vkh_device_gpu_to_host_time (prof->dev, begin) : 0;
+		m->result	= prof->resultCount++;
+		if (prof->capture)
+			_append_trace (prof, r, frame->frameIndex);
+		if (m->submit != PROFILER_NONE)
+			_add_submit_region (&prof->submitResults[m->submit], (begin - prof->baseTick) & prof->tickMask,
+								(end - prof->baseTick) & prof->tickMask);
+	}
+	_finish_submits (prof, frame);
+	return true;
+}
+/**
+ * @brief start profiling a new frame, the query pool of the frame slot is reset in 'cmd' which has to be
+ * submitted before any other labeled command buffer of the frame. Waits for the results of the slot only if
+ * they are still not available after 'frameCount' frames.
+ */
+void vkh_profiler_begin_frame (VkhProfiler prof, VkCommandBuffer cmd) {
+	mtx_lock (&prof->mutex);
+	vkh_profiler_frame_t* frame = &prof->frames[prof->current];
+	if (frame->pending)
+		_resolve (prof, frame, true);
+	vkCmdResetQueryPool (cmd, frame->pool, 0, prof->maxRegions * 2);
+	frame->markCount	= 0;
+	frame->submitCount	= 0;
+	frame->frameIndex	= prof->frameIndex++;
+	prof->stackCount	= 0;
+	prof->recording		= true;
+	mtx_unlock (&prof->mutex);
+}
+//close the frame and read back every frame whose timestamps are available.
+void vkh_profiler_end_frame (VkhProfiler prof) {
+	mtx_lock (&prof->mutex);
+	vkh_profiler_frame_t* frame = &prof->frames[prof->current];
+	frame->pending		= frame->markCount > 0;
+	prof->stackCount	= 0;
+	prof->recording		= false;
+	prof->current		= (prof->current + 1) % prof->frameCount;
+	mtx_unlock (&prof->mutex);
+	vkh_profiler_collect (prof);
+}
+void vkh_profiler_collect (VkhProfiler prof) {
+	mtx_lock (&prof->mutex);
+	//oldest first
+	for (uint32_t i=0; i<prof->frameCount; i++) {
+		vkh_profiler_frame_t* frame = &prof->frames[(prof->current + i) % prof->frameCount];
+		if (frame->pending && !_resolve (prof, frame, false))
+			break;
+	}
+	mtx_unlock (&prof->mutex);
+}
+/**
+ * @brief copy the regions of the last frame read back, in opening order. Start times are in milliseconds from the
+ * first region ever resolved, parent is an index in the same array or UINT32_MAX for top level regions.
+ * @param regions array of 'maxRegions' elements, or NULL to only query the count.
+ * @return the number of regions copied, or available if 'regions' is NULL.
+ */
+uint32_t vkh_profiler_get_results (VkhProfiler prof, VkhGpuRegion* regions, uint32_t maxRegions, uint64_t* pFrameIndex) {
+	mtx_lock (&prof->mutex);
+	uint32_t count = prof->resultCount;
+	if (regions) {
+		count = MIN(count, maxRegions);
+		memcpy (regions, prof->results, count * sizeof(VkhGpuRegion));
+	}
+	if (pFrameIndex)
+		*pFrameIndex = prof->resultFrame;
+	mtx_unlock (&prof->mutex);
+	return count;
+}
+/**
+ * @brief copy the submissions of the last frame read back that contained labeled regions, in submission order.
+ * @param submits array of 'maxSubmits' elements, or NULL to only query the count.
+ * @return the number of submissions copied, or available if 'submits' is NULL.
+ */
+uint32_t vkh_profiler_get_submits (VkhProfiler prof, VkhGpuSubmit* submits, uint32_t maxSubmits, uint64_t* pFrameIndex) {
+	mtx_lock (&prof->mutex);
+	uint32_t count = prof->submitResultCount;
+	if (submits) {
+		count = MIN(count, maxSubmits);
+		memcpy (submits, prof->submitResults, count * sizeof(VkhGpuSubmit));
+	}
+	if (pFrameIndex)
+		*pFrameIndex = prof->resultFrame;
+	mtx_unlock (&prof->mutex);
+	return count;
+}
+//keep the regions of every resolved frame for vkh_profiler_export_trace.
+void vkh_profiler_set_capture (VkhProfiler prof, bool capture) {
+	mtx_lock (&prof->mutex);
+	prof->capture = capture;
+	mtx_unlock (&prof->mutex);
+}
+static void _write_json_string (FILE* f, const char* str) {
+	fputc ('"', f);
+	for (const char* c = str; *c; c++) {
+		if (*c == '"' || *c == '\\')
+			fputc ('\\', f);
+		if ((unsigned char)*c >= 0x20)
+			fputc (*c, f);
+	}
+	fputc ('"', f);
+}
+/**
+ * @brief write captured regions as Chrome trace event JSON (chrome://tracing, Perfetto) and clear them.
+ * Once the device is calibrated, events are placed on the vkh_host_time clock to line up with CPU traces.
+ */
+bool vkh_profiler_export_trace (VkhProfiler prof, const char* path) {
+	FILE* f = fopen (path, "w");
+	if (f == NULL) {
+		perror ("vkh_profiler_export_trace");
+		return false;
+	}
+	mtx_lock (&prof->mutex);
+	fprintf (f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf (f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"GPU\"}}");
+	for (uint32_t i=0; i<prof->traceCount; i++) {
+		const VkhGpuRegion* r = &prof->trace[i];
+		fprintf (f, ",\n{\"name\":");
+		_write_json_string (f, r->name);
+		fprintf (f, ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+				 r->hostTime ? (double)r->hostTime / 1000.0 : r->start * 1000.0, r->duration * 1000.0, (unsigned long long)prof->traceFrames[i]);
+	}
+	fprintf (f, "\n]}\n");
+	prof->traceCount = 0;
+	mtx_unlock (&prof->mutex);
+	return fclose (f) == 0;
+}
+
+//timestamps are written outside of the lock, it only guards the marks and the stacks.
+void vkh_profiler_label_start (VkhProfiler prof, VkCommandBuffer cmd, const char* name) {
+	mtx_lock (&prof->mutex);
+	if (!prof->recording) {
+		mtx_unlock (&prof->mutex);
+		return;
+	}
+	vkh_profiler_frame_t* frame = &prof->frames[prof->current];
+	vkh_profiler_stack_t* stack = _find_stack (prof, cmd);
+	if (stack == NULL) {
+		if (prof->stackCount == prof->stackReserved) {
+			prof->stackReserved = prof->stackReserved ? prof->stackReserved * 2 : VKH_PROFILER_INIT_SIZE;
+			prof->stacks = (vkh_profiler_stack_t*)realloc(prof->stacks, prof->stackReserved * sizeof(vkh_profiler_stack_t));
+		}
+		stack = &prof->stacks[prof->stackCount++];
+		stack->cmd		= cmd;
+		stack->depth	= 0;
+	}
+	uint32_t idx = PROFILER_NONE;
+	VkQueryPool pool = frame->pool;
+	if (frame->markCount < prof->maxRegions && stack->depth < VKH_PROFILER_MAX_DEPTH) {
+		idx = frame->markCount++;
+		vkh_profiler_mark_t* m = &frame->marks[idx];
+		strncpy (m->name, name ? name : "", VKH_PROFILER_NAME_SIZE - 1);
+		m->name[VKH_PROFILER_NAME_SIZE - 1] = 0;
+		m->depth	= stack->depth;
+		m->parent	= stack->depth > 0 ? stack->regions[stack->depth - 1] : PROFILER_NONE;
+		m->query	= idx * 2;
+		m->closed	= false;
+		m->cmd		= cmd;
+		m->submit	= PROFILER_NONE;
+	}
+	if (stack->depth < VKH_PROFILER_MAX_DEPTH)
+		stack->regions[stack->depth] = idx;
+	stack->depth++;
+	mtx_unlock (&prof->mutex);
+	if (idx != PROFILER_NONE)
+		vkCmdWriteTimestamp (cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool, idx * 2);
+}
+void vkh_profiler_label_end (VkhProfiler prof, VkCommandBuffer cmd) {
+	mtx_lock (&prof->mutex);
+	vkh_profiler_stack_t* stack = _find_stack (prof, cmd);
+	if (stack == NULL) {
+		mtx_unlock (&prof->mutex);
+		return;
+	}
+	vkh_profiler_frame_t* frame = &prof->frames[prof->current];
+	VkQueryPool pool = frame->pool;
+	stack->depth--;
+	uint32_t idx = stack->depth < VKH_PROFILER_MAX_DEPTH ? stack->regions[stack->depth] : PROFILER_NONE;
+	if (idx != PROFILER_NONE)
+		frame->marks[idx].closed = true;
+	if (stack->depth == 0)
+		*stack = prof->stacks[--prof->stackCount];
+	mtx_unlock (&prof->mutex);
+	if (idx != PROFILER_NONE)
+		vkCmdWriteTimestamp (cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool, idx * 2 + 1);
+}
+static uint32_t _frame_submit (vkh_profiler_frame_t* frame, VkQueue queue, uint64_t hostTime) {
+	if (frame->submitCount == frame->submitReserved) {
+		frame->submitReserved = frame->submitReserved ? frame->submitReserved * 2 : VKH_PROFILER_INIT_SIZE;
+		frame->submits = (vkh_profiler_submit_t*)realloc(frame->submits, frame->submitReserved * sizeof(vkh_profiler_submit_t));
+	}
+	frame->submits[frame->submitCount] = (vkh_profiler_submit_t) { queue, hostTime };
+	return frame->submitCount++;
+}
+/**
+ * @brief called by VkhQueue after each vkQueueSubmit, regions recorded in the submitted command buffers are
+ * attached to a submission of their frame to measure its latency and the queue idle gaps.
+ */
+void vkh_profiler_submitted (VkhProfiler prof, VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, uint64_t hostTime) {
+	mtx_lock (&prof->mutex);
+	for (uint32_t f=0; f<prof->frameCount; f++) {
+		vkh_profiler_frame_t* frame = &prof->frames[f];
+		if (!frame->pending && !(prof->recording && f == prof->current))
+			continue;
+		uint32_t submit = PROFILER_NONE;
+		for (uint32_t i=0; i<frame->markCount; i++) {
+			vkh_profiler_mark_t* m = &frame->marks[i];
+			if (m->submit != PROFILER_NONE)
+				continue;
+			for (uint32_t s=0; s<submitCount && m->submit == PROFILER_NONE; s++) {
+				for (uint32_t c=0; c<pSubmits[s].commandBufferCount; c++) {
+					if (pSubmits[s].pCommandBuffers[c] != m->cmd)
+						continue;
+					if (submit == PROFILER_NONE)
+						submit = _frame_submit (frame, queue, hostTime);
+					m->submit = submit;
+					break;
+				}
+			}
+		}
+	}
+	mtx_unlock (&prof->mutex);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef VKH_PROFILER_H
+#define VKH_PROFILER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "vkh.h"
+#include "deps/tinycthread.h"
+
+#define VKH_PROFILER_MAX_DEPTH	16
+#define VKH_PROFILER_INIT_SIZE	8
+#define PROFILER_NONE			UINT32_MAX
+
+typedef struct {
+	char					name[VKH_PROFILER_NAME_SIZE];
+	uint32_t				depth;
+	uint32_t				parent;
+	uint32_t				query;//begin timestamp query, end is query + 1
+	bool					closed;//end timestamp written
+	uint32_t				result;//index in resolved regions
+	VkCommandBuffer			cmd;
+	uint32_t				submit;//index in the frame submissions, PROFILER_NONE until submitted
+}vkh_profiler_mark_t;
+
+//vkQueueSubmit containing labeled command buffers of a frame.
+typedef struct {
+	VkQueue					queue;
+	uint64_t				hostTime;
+}vkh_profiler_submit_t;
+
+//regions opened in a command buffer and not yet closed.
+typedef struct {
+	VkCommandBuffer			cmd;
+	uint32_t				regions[VKH_PROFILER_MAX_DEPTH];
+	uint32_t				depth;
+}vkh_profiler_stack_t;
+
+typedef struct {
+	VkQueryPool				pool;
+	vkh_profiler_mark_t*	marks;
+	uint32_t				markCount;
+	uint64_t				frameIndex;
+	bool					pending;//recorded, results not yet read back
+	vkh_profiler_submit_t*	submits;
+	uint32_t				submitCount;
+	uint32_t				submitReserved;
+}vkh_profiler_frame_t;
+
+typedef struct _vkh_profiler_t {
+	VkhDevice				dev;
+	mtx_t					mutex;
+	uint32_t				maxRegions;//per frame
+	uint32_t				frameCount;
+	vkh_profiler_frame_t*	frames;
+	uint32_t				current;
+	uint64_t				frameIndex;
+	bool					recording;//between begin_frame and end_frame
+	double					period;//nanoseconds per tick
+	uint64_t				tickMask;
+	uint64_t				baseTick;//first resolved timestamp, origin of the exported trace
+	bool					baseSet;
+	vkh_profiler_stack_t*	stacks;
+	uint32_t				stackCount;
+	uint32_t				stackReserved;
+	uint64_t*				queryData;//timestamp and availability pairs
+	VkhGpuRegion*			results;//last resolved frame
+	uint32_t				resultCount;
+	uint64_t				resultFrame;
+	VkhGpuSubmit*			submitResults;//submissions of the last resolved frame
+	uint32_t				submitResultCount;
+	uint32_t				submitResultReserved;
+	bool					capture;
+	VkhGpuRegion*			trace;//regions of all resolved frames while capturing
+	uint64_t*				traceFrames;
+	uint32_t				traceCount;
+	uint32_t				traceReserved;
+}vkh_profiler_t;
+
+void vkh_profiler_label_start	(VkhProfiler prof, VkCommandBuffer cmd, const char* name);
+void vkh_profiler_label_end		(VkhProfiler prof, VkCommandBuffer cmd);
+void vkh_profiler_submitted		(VkhProfiler prof, VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, uint64_t hostTime);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
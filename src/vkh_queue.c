@@ -22,10 +22,16 @@
 #include "vkh_queue.h"
 #include "vkh_device.h"
 #include "vkh_phyinfo.h"
+#include "vkh_stats.h"
+#include "vkh_profiler.h"
+
+#define QUEUE_ENTRIES_INIT_SIZE	16
 
 VkhQueue _init_queue (VkhDevice dev) {
 	VkhQueue q	= (vkh_queue_t*)calloc(1, sizeof(vkh_queue_t));
 	q->dev = dev;
+	mtx_init (&q->mutex, mtx_plain);
+	cnd_init (&q->submitCond);
 	return q;
 }
 
@@ -43,5 +49,196 @@ VkhQueue vkh_queue_create (VkhDevice dev, uint32_t familyIndex, uint32_t qIndex)
 //}
 
 void vkh_queue_destroy (VkhQueue queue){
+	vkh_queue_stop_submit_thread (queue);
+	vkh_queue_flush (queue);
+	free (queue->entries);
+	cnd_destroy (&queue->submitCond);
+	mtx_destroy (&queue->mutex);
 	free (queue);
 }
+/**
+ * @brief lock the queue for direct use of the VkQueue handle, for ex. for vkQueuePresentKHR.
+ */
+void vkh_queue_lock (VkhQueue queue) {
+	mtx_lock (&queue->mutex);
+}
+void vkh_queue_unlock (VkhQueue queue) {
+	mtx_unlock (&queue->mutex);
+}
+
+static void _copy_submit (vkh_submit_entry_t* e, const VkSubmitInfo* src) {
+	const VkTimelineSemaphoreSubmitInfo* tl = NULL;
+	for (const VkBaseInStructure* s = (const VkBaseInStructure*)src->pNext; s; s = s->pNext) {
+		if (s->sType == VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO)
+			tl = (const VkTimelineSemaphoreSubmitInfo*)s;
+	}
+	size_t size = src->waitSemaphoreCount * (sizeof(VkSemaphore) + sizeof(VkPipelineStageFlags))
+				+ src->commandBufferCount * sizeof(VkCommandBuffer)
+				+ src->signalSemaphoreCount * sizeof(VkSemaphore);
+	if (tl)
+		size += (tl->waitSemaphoreValueCount + tl->signalSemaphoreValueCount) * sizeof(uint64_t);
+
+	//64 bit values first to keep them aligned
+	char* p = (char*)malloc(size ? size : 1);
+	e->data		= p;
+	e->info		= *src;
+	e->info.pNext = NULL;
+	e->timelined = tl != NULL;
+	if (tl) {
+		e->timeline = *tl;
+		e->timeline.pNext = NULL;
+		memcpy (p, tl->pWaitSemaphoreValues, tl->waitSemaphoreValueCount * sizeof(uint64_t));
+		e->timeline.pWaitSemaphoreValues = (const uint64_t*)p;
+		p += tl->waitSemaphoreValueCount * sizeof(uint64_t);
+		memcpy (p, tl->pSignalSemaphoreValues, tl->signalSemaphoreValueCount * sizeof(uint64_t));
+		e->timeline.pSignalSemaphoreValues = (const uint64_t*)p;
+		p += tl->signalSemaphoreValueCount * sizeof(uint64_t);
+	}
+	memcpy (p, src->pWaitSemaphores, src->waitSemaphoreCount * sizeof(VkSemaphore));
+	e->info.pWaitSemaphores = (const VkSemaphore*)p;
+	p += src->waitSemaphoreCount * sizeof(VkSemaphore);
+	memcpy (p, src->pCommandBuffers, src->commandBufferCount * sizeof(VkCommandBuffer));
+	e->info.pCommandBuffers = (const VkCommandBuffer*)p;
+	p += src->commandBufferCount * sizeof(VkCommandBuffer);
+	memcpy (p, src->pSignalSemaphores, src->signalSemaphoreCount * sizeof(VkSemaphore));
+	e->info.pSignalSemaphores = (const VkSemaphore*)p;
+	p += src->signalSemaphoreCount * sizeof(VkSemaphore);
+	memcpy (p, src->pWaitDstStageMask, src->waitSemaphoreCount * sizeof(VkPipelineStageFlags));
+	e->info.pWaitDstStageMask = (const VkPipelineStageFlags*)p;
+}
+//pair the submitted command buffers with the labeled regions of the profiler attached to the device.
+static void _profile_submit (VkhQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, uint64_t hostTime) {
+	VkhProfiler prof = vkh_atomic_ptr_load_explicit (&queue->dev->profiler, vkh_memory_order_acquire);
+	if (prof)
+		vkh_profiler_submitted (prof, queue->queue, submitCount, pSubmits, hostTime);
+}
+/**
+ * @brief submit all the enqueued entries with as few vkQueueSubmit as possible, a call is only split
+ * after an entry carrying a fence. Queue has to be locked.
+ */
+static VkResult _flush_locked (VkhQueue queue) {
+	if (queue->entryCount == 0)
+		return VK_SUCCESS;
+	VkResult result = VK_SUCCESS;
+	VkSubmitInfo* infos = (VkSubmitInfo*)malloc(queue->entryCount * sizeof(VkSubmitInfo));
+	uint32_t first = 0;
+	for (uint32_t i=0; i<queue->entryCount; i++) {
+		vkh_submit_entry_t* e = &queue->entries[i];
+		infos[i] = e->info;
+		if (e->timelined)
+			infos[i].pNext = &e->timeline;
+		if (e->fence == VK_NULL_HANDLE && i + 1 < queue->entryCount)
+			continue;
+		uint64_t submitTime = vkh_host_time ();
+		vkh_atomic_store (&queue->submitTime, submitTime);
+		VkResult res = vkQueueSubmit (queue->queue, i + 1 - first, &infos[first], e->fence);
+		_profile_submit (queue, i + 1 - first, &infos[first], submitTime);
+		VKH_STAT_ADD(VKH_STAT_SUBMITS, 1);
+		VKH_STAT_ADD(VKH_STAT_SUBMIT_INFOS, i + 1 - first);
+		if (res != VK_SUCCESS && result == VK_SUCCESS)
+			result = res;
+		first = i + 1;
+	}
+	for (uint32_t i=0; i<queue->entryCount; i++)
+		free (queue->entries[i].data);
+	queue->entryCount = 0;
+	free (infos);
+	return result;
+}
+/**
+ * @brief copy submissions to be sent with the next flush, either explicit or done by the submit thread.
+ * Arrays and timeline values chained in pNext are copied, other pNext structures are ignored.
+ * @param fence signaled when these and all the previously enqueued submissions have completed.
+ */
+void vkh_queue_enqueue (VkhQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence) {
+	mtx_lock (&queue->mutex);
+	if (queue->entryCount + submitCount + 1 > queue->entryReserved) {
+		queue->entryReserved = queue->entryReserved ? queue->entryReserved * 2 : QUEUE_ENTRIES_INIT_SIZE;
+		while (queue->entryCount + submitCount + 1 > queue->entryReserved)
+			queue->entryReserved *= 2;
+		queue->entries = (vkh_submit_entry_t*)realloc(queue->entries, queue->entryReserved * sizeof(vkh_submit_entry_t));
+	}
+	for (uint32_t i=0; i<submitCount; i++) {
+		vkh_submit_entry_t* e = &queue->entries[queue->entryCount++];
+		_copy_submit (e, &pSubmits[i]);
+		e->fence = VK_NULL_HANDLE;
+	}
+	if (fence != VK_NULL_HANDLE) {
+		if (submitCount == 0) {//fence only, signal it with an empty batch
+			VkSubmitInfo empty = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO };
+			_copy_submit (&queue->entries[queue->entryCount++], &empty);
+		}
+		queue->entries[queue->entryCount - 1].fence = fence;
+	}
+	if (queue->submitThreadRunning)
+		cnd_signal (&queue->submitCond);
+	mtx_unlock (&queue->mutex);
+}
+//submit enqueued entries now, from the calling thread.
+VkResult vkh_queue_flush (VkhQueue queue) {
+	mtx_lock (&queue->mutex);
+	VkResult res = _flush_locked (queue);
+	mtx_unlock (&queue->mutex);
+	return res;
+}
+/**
+ * @brief thread safe vkQueueSubmit, enqueued entries are flushed first to keep submission order.
+ */
+VkResult vkh_queue_submit (VkhQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence) {
+	mtx_lock (&queue->mutex);
+	VkResult res = _flush_locked (queue);
+	if (res == VK_SUCCESS) {
+		uint64_t submitTime = vkh_host_time ();
+		vkh_atomic_store (&queue->submitTime, submitTime);
+		res = vkQueueSubmit (queue->queue, submitCount, pSubmits, fence);
+		_profile_submit (queue, submitCount, pSubmits, submitTime);
+		VKH_STAT_ADD(VKH_STAT_SUBMITS, 1);
+		VKH_STAT_ADD(VKH_STAT_SUBMIT_INFOS, submitCount);
+	}
+	mtx_unlock (&queue->mutex);
+	return res;
+}
+//host time of the last vkQueueSubmit on this queue, per submission latencies are given by vkh_profiler_get_submits.
+uint64_t vkh_queue_get_submit_time (VkhQueue queue) {
+	return vkh_atomic_load (&queue->submitTime);
+}
+
+static int _submit_thread (void* arg) {
+	VkhQueue queue = (VkhQueue)arg;
+	mtx_lock (&queue->mutex);
+	while (queue->submitThreadRunning) {
+		if (queue->entryCount == 0)
+			cnd_wait (&queue->submitCond, &queue->mutex);
+		VkResult res = _flush_locked (queue);
+		if (res != VK_SUCCESS)
+			fprintf (stderr, "vkh_queue submit thread: vkQueueSubmit failed (%d)\n", res);
+	}
+	mtx_unlock (&queue->mutex);
+	return 0;
+}
+/**
+ * @brief start a thread flushing enqueued submissions as soon as they arrive, submissions enqueued
+ * while it is busy are grouped in the next vkQueueSubmit.
+ */
+void vkh_queue_start_submit_thread (VkhQueue queue) {
+	mtx_lock (&queue->mutex);
+	if (queue->submitThreadRunning) {
+		mtx_unlock (&queue->mutex);
+		return;
+	}
+	queue->submitThreadRunning = true;
+	mtx_unlock (&queue->mutex);
+	thrd_create (&queue->submitThread, _submit_thread, queue);
+}
+//stop the submit thread, remaining entries are submitted on next flush.
+void vkh_queue_stop_submit_thread (VkhQueue queue) {
+	mtx_lock (&queue->mutex);
+	if (!queue->submitThreadRunning) {
+		mtx_unlock (&queue->mutex);
+		return;
+	}
+	queue->submitThreadRunning = false;
+	cnd_signal (&queue->submitCond);
+	mtx_unlock (&queue->mutex);
+	thrd_join (queue->submitThread, NULL);
+}
@@ -27,12 +27,31 @@ extern "C" {
 #endif
 
 #include "vkh.h"
+#include "deps/tinycthread.h"
+#include "vkh_atomic.h"
+
+//deep copy of an enqueued VkSubmitInfo, arrays are stored in 'data'.
+typedef struct {
+	VkSubmitInfo					info;
+	VkTimelineSemaphoreSubmitInfo	timeline;//chained in info if timelined is true
+	bool							timelined;
+	VkFence							fence;//submission containing this entry has to signal it
+	void*							data;
+}vkh_submit_entry_t;
 
 typedef struct _vkh_queue_t{
 	VkhDevice		dev;
 	uint32_t		familyIndex;
 	VkQueue			queue;
 	VkQueueFlags	flags;
+	mtx_t			mutex;//external synchronization of the VkQueue
+	cnd_t			submitCond;//wake up submit thread
+	thrd_t			submitThread;
+	bool			submitThreadRunning;
+	vkh_submit_entry_t*	entries;//enqueued submissions waiting for the next flush
+	uint32_t		entryCount;
+	uint32_t		entryReserved;
+	vkh_atomic_ullong	submitTime;//vkh_host_time of the last vkQueueSubmit
 }vkh_queue_t;
 
 #ifdef __cplusplus
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vkh_queue_manager.h"
+#include "vkh_queue.h"
+#include "vkh_device.h"
+
+/**
+ * @brief create a VkhQueue for every queue of the create infos used for the device, for ex. the ones
+ * returned by vkh_phyinfo_create_all_queues.
+ * @param surface used to test presentation support of each family, may be VK_NULL_HANDLE.
+ */
+VkhQueueManager vkh_queue_manager_create (VkhDevice dev, VkSurfaceKHR surface, const VkDeviceQueueCreateInfo* pQueueInfos,
+										  uint32_t queueInfoCount, VkhQueueBalance balance) {
+	VkhQueueManager qm = (VkhQueueManager)calloc(1, sizeof(vkh_queue_manager_t));
+	qm->dev			= dev;
+	qm->balance		= balance;
+	qm->familyCount	= queueInfoCount;
+	qm->families	= (vkh_queue_family_t*)calloc(queueInfoCount, sizeof(vkh_queue_family_t));
+	mtx_init (&qm->mutex, mtx_plain);
+
+	uint32_t famCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties (dev->phy, &famCount, NULL);
+	VkQueueFamilyProperties* props = (VkQueueFamilyProperties*)malloc(famCount * sizeof(VkQueueFamilyProperties));
+	vkGetPhysicalDeviceQueueFamilyProperties (dev->phy, &famCount, props);
+
+	for (uint32_t i=0; i<queueInfoCount; i++) {
+		vkh_queue_family_t* f = &qm->families[i];
+		f->familyIndex	= pQueueInfos[i].queueFamilyIndex;
+		f->flags		= props[f->familyIndex].queueFlags;
+		f->count		= pQueueInfos[i].queueCount;
+		f->queues		= (vkh_managed_queue_t*)calloc(f->count, sizeof(vkh_managed_queue_t));
+		if (surface != VK_NULL_HANDLE) {
+			VkBool32 present = VK_FALSE;
+			vkGetPhysicalDeviceSurfaceSupportKHR (dev->phy, f->familyIndex, surface, &present);
+			f->present = present == VK_TRUE;
+		}
+		for (uint32_t q=0; q<f->count; q++) {
+			f->queues[q].queue = vkh_queue_create (dev, f->familyIndex, q);
+			f->queues[q].queue->flags = f->flags;
+		}
+	}
+	free (props);
+	return qm;
+}
+void vkh_queue_manager_destroy (VkhQueueManager qm) {
+	if (qm == NULL)
+		return;
+	for (uint32_t i=0; i<qm->familyCount; i++) {
+		for (uint32_t q=0; q<qm->families[i].count; q++)
+			vkh_queue_destroy (qm->families[i].queues[q].queue);
+		free (qm->families[i].queues);
+	}
+	free (qm->families);
+	mtx_destroy (&qm->mutex);
+	free (qm);
+}
+//higher is better, negative if family can't be used for 'usage'.
+static int _score (const vkh_queue_family_t* f, VkhQueueUsage usage) {
+	bool graphics	= (f->flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+	bool compute	= (f->flags & VK_QUEUE_COMPUTE_BIT) != 0;
+	bool transfer	= (f->flags & VK_QUEUE_TRANSFER_BIT) != 0;
+	switch (usage) {
+	case VKH_QUEUE_USAGE_GRAPHICS:
+		if (!graphics)
+			return -1;
+		return f->present ? 2 : 1;
+	case VKH_QUEUE_USAGE_PRESENT:
+		if (!f->present)
+			return -1;
+		return graphics ? 2 : 1;
+	case VKH_QUEUE_USAGE_ASYNC_COMPUTE:
+		if (!compute)
+			return -1;
+		return graphics ? 1 : 4;//dedicated compute family runs beside graphics
+	case VKH_QUEUE_USAGE_TRANSFER:
+		//graphics and compute queues implicitly support transfer
+		if (!(transfer || graphics || compute))
+			return -1;
+		if (!graphics && !compute)
+			return 8;//dma engine
+		return graphics ? 1 : 2;
+	}
+	return -1;
+}
+static vkh_queue_family_t* _best_family (VkhQueueManager qm, VkhQueueUsage usage) {
+	vkh_queue_family_t* best = NULL;
+	int bestScore = -1;
+	for (uint32_t i=0; i<qm->familyCount; i++) {
+		vkh_queue_family_t* f = &qm->families[i];
+		int score = _score (f, usage);
+		if (f->count > 0 && score > bestScore) {
+			best = f;
+			bestScore = score;
+		}
+	}
+	return best;
+}
+//queue family index the manager would choose for 'usage', -1 if none.
+int vkh_queue_manager_get_family (VkhQueueManager qm, VkhQueueUsage usage) {
+	vkh_queue_family_t* f = _best_family (qm, usage);
+	return f ? (int)f->familyIndex : -1;
+}
+/**
+ * @brief get a queue of the best family for 'usage', chosen in this family according to the manager balance mode.
+ * Each acquired queue has to be given back with @ref vkh_queue_manager_release.
+ * @return NULL if no family supports 'usage'.
+ */
+VkhQueue vkh_queue_manager_acquire (VkhQueueManager qm, VkhQueueUsage usage) {
+	vkh_queue_family_t* f = _best_family (qm, usage);
+	if (f == NULL)
+		return NULL;
+	mtx_lock (&qm->mutex);
+	vkh_managed_queue_t* mq;
+	if (qm->balance == VKH_QUEUE_BALANCE_ROUND_ROBIN) {
+		mq = &f->queues[f->next];
+		f->next = (f->next + 1) % f->count;
+	} else {
+		mq = &f->queues[0];
+		for (uint32_t q=1; q<f->count; q++) {
+			if (f->queues[q].leases < mq->leases)
+				mq = &f->queues[q];
+		}
+	}
+	mq->leases++;
+	mtx_unlock (&qm->mutex);
+	return mq->queue;
+}
+void vkh_queue_manager_release (VkhQueueManager qm, VkhQueue queue) {
+	mtx_lock (&qm->mutex);
+	for (uint32_t i=0; i<qm->familyCount; i++) {
+		vkh_queue_family_t* f = &qm->families[i];
+		if (f->familyIndex != queue->familyIndex)
+			continue;
+		for (uint32_t q=0; q<f->count; q++) {
+			if (f->queues[q].queue == queue && f->queues[q].leases > 0)
+				f->queues[q].leases--;
+		}
+	}
+	mtx_unlock (&qm->mutex);
+}
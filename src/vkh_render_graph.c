@@ -0,0 +1,686 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vkh_render_graph.h"
+#include "vkh_device.h"
+#include "vkh_queue.h"
+#include "vkh_image.h"
+#include "vkh_buffer.h"
+#include "vkh_stats.h"
+
+#ifndef MAX
+# define MAX(a,b) (((a) > (b)) ? (a) : (b))
+#endif
+
+VkhRenderGraph vkh_render_graph_create (VkhDevice dev) {
+	VkhRenderGraph g = (VkhRenderGraph)calloc(1, sizeof(vkh_render_graph_t));
+	g->dev			= dev;
+	g->timelines[0]	= vkh_timeline_create (dev, 0);
+	g->timelines[1]	= vkh_timeline_create (dev, 0);
+	g->families[0]	= g->families[1] = VK_QUEUE_FAMILY_IGNORED;
+	g->submit		= vkh_submit_create ();
+	return g;
+}
+static void _wait_frames (VkhRenderGraph g, uint32_t q) {
+	for (uint32_t f=0; f<VKH_GRAPH_FRAMES; f++) {
+		if (g->frames[f].values[q] > 0)
+			vkh_timeline_wait (g->dev, g->timelines[q], g->frames[f].values[q]);
+	}
+}
+static void _destroy_pools (VkhRenderGraph g, uint32_t q) {
+	for (uint32_t f=0; f<VKH_GRAPH_FRAMES; f++) {
+		vkh_graph_frame_t* fr = &g->frames[f];
+		if (fr->pools[q] != VK_NULL_HANDLE)
+			vkDestroyCommandPool (g->dev->dev, fr->pools[q], NULL);
+		free (fr->cmds[q]);
+		fr->pools[q]	= VK_NULL_HANDLE;
+		fr->cmds[q]		= NULL;
+		fr->cmdCount[q]	= fr->cmdUsed[q] = 0;
+	}
+}
+void vkh_render_graph_destroy (VkhRenderGraph g) {
+	if (g == NULL)
+		return;
+	for (uint32_t q=0; q<2; q++) {
+		_wait_frames (g, q);
+		_destroy_pools (g, q);
+		vkDestroySemaphore (g->dev->dev, g->timelines[q], NULL);
+	}
+	for (uint32_t i=0; i<g->resourceCount; i++) {
+		vkh_graph_resource_t* r = &g->resources[i];
+		if (!r->transient)
+			continue;
+		if (r->type == VK_OBJECT_TYPE_IMAGE)
+			vkh_image_destroy_force ((VkhImage)r->object);
+		else
+			vkh_buffer_destroy_force ((VkhBuffer)r->object);
+	}
+	if (g->aliasPool)
+		vkh_alias_pool_destroy (g->aliasPool);
+	for (uint32_t i=0; i<g->passCount; i++)
+		free (g->passes[i].accesses);
+	free (g->passes);
+	free (g->resources);
+	free (g->order);
+	free (g->batches);
+	free (g->imgBarriers);
+	free (g->buffBarriers);
+	vkh_submit_destroy (g->submit);
+	free (g);
+}
+
+static uint32_t _add_resource (VkhRenderGraph g, VkObjectType type, void* object, bool transient) {
+	if (g->resourceCount == g->resourceReserved) {
+		g->resourceReserved = g->resourceReserved ? g->resourceReserved * 2 : VKH_GRAPH_INIT_SIZE;
+		g->resources = (vkh_graph_resource_t*)realloc(g->resources, g->resourceReserved * sizeof(vkh_graph_resource_t));
+	}
+	vkh_graph_resource_t* r = &g->resources[g->resourceCount];
+	memset (r, 0, sizeof(vkh_graph_resource_t));
+	r->type			= type;
+	r->object		= object;
+	r->transient	= transient;
+	r->aspect		= VK_IMAGE_ASPECT_COLOR_BIT;
+	r->aliasFirst	= VKH_GRAPH_NONE;
+	return g->resourceCount++;
+}
+/**
+ * @brief make an image owned by the application usable by the passes, its tracked layout is used and updated.
+ */
+uint32_t vkh_render_graph_import_image (VkhRenderGraph g, VkhImage img, VkImageAspectFlags aspectMask) {
+	uint32_t res = _add_resource (g, VK_OBJECT_TYPE_IMAGE, img, false);
+	g->resources[res].aspect = aspectMask;
+	return res;
+}
+uint32_t vkh_render_graph_import_buffer (VkhRenderGraph g, VkhBuffer buff) {
+	return _add_resource (g, VK_OBJECT_TYPE_BUFFER, buff, false);
+}
+//replace an imported image between two executions, for ex. with the swapchain image of the frame.
+void vkh_render_graph_update_image (VkhRenderGraph g, uint32_t res, VkhImage img) {
+	g->resources[res].object = img;
+}
+/**
+ * @brief create a transient image owned by the graph, its memory is aliased with the other transient resources
+ * whose lifetimes do not overlap. Memory is bound on compile, views have to be created after. When a later
+ * compilation changes the transient lifetimes, the images are created again and have to be fetched again.
+ */
+uint32_t vkh_render_graph_create_image (VkhRenderGraph g, VkFormat format, uint32_t width, uint32_t height,
+										VkImageUsageFlags usage, VkImageAspectFlags aspectMask) {
+	VkhImage img = vkh_image_create_unbound (g->dev, format, width, height, VK_IMAGE_TILING_OPTIMAL, usage);
+	uint32_t res = _add_resource (g, VK_OBJECT_TYPE_IMAGE, img, true);
+	g->resources[res].aspect = aspectMask;
+	return res;
+}
+uint32_t vkh_render_graph_create_buffer (VkhRenderGraph g, VkBufferUsageFlags usage, VkDeviceSize size) {
+	return _add_resource (g, VK_OBJECT_TYPE_BUFFER, vkh_buffer_create_unbound (g->dev, usage, size), true);
+}
+VkhImage vkh_render_graph_get_image (VkhRenderGraph g, uint32_t res) {
+	return (VkhImage)g->resources[res].object;
+}
+VkhBuffer vkh_render_graph_get_buffer (VkhRenderGraph g, uint32_t res) {
+	return (VkhBuffer)g->resources[res].object;
+}
+/**
+ * @brief mark a resource as a result of the graph, passes not contributing to an output are culled.
+ * @param finalLayout layout the image is left in after execution, VK_IMAGE_LAYOUT_UNDEFINED to keep the last one.
+ */
+void vkh_render_graph_set_output (VkhRenderGraph g, uint32_t res, VkImageLayout finalLayout) {
+	g->resources[res].output		= true;
+	g->resources[res].finalLayout	= finalLayout;
+}
+uint32_t vkh_render_graph_add_pass (VkhRenderGraph g, const char* name, VkhGraphQueue queue, VkhPassFunc func, void* userData) {
+	if (g->passCount == g->passReserved) {
+		g->passReserved = g->passReserved ? g->passReserved * 2 : VKH_GRAPH_INIT_SIZE;
+		g->passes = (vkh_graph_pass_t*)realloc(g->passes, g->passReserved * sizeof(vkh_graph_pass_t));
+	}
+	vkh_graph_pass_t* p = &g->passes[g->passCount];
+	memset (p, 0, sizeof(vkh_graph_pass_t));
+	if (name)
+		strncpy (p->name, name, VKH_GRAPH_NAME_SIZE - 1);
+	p->queue	= queue;
+	p->func		= func;
+	p->userData	= userData;
+	g->compiled	= false;
+	return g->passCount++;
+}
+static void _add_access (VkhRenderGraph g, uint32_t pass, uint32_t res, bool write, VkImageLayout layout,
+						 VkPipelineStageFlags stages, VkAccessFlags access) {
+	vkh_graph_pass_t* p = &g->passes[pass];
+	if (p->accessCount == p->accessReserved) {
+		p->accessReserved = p->accessReserved ? p->accessReserved * 2 : VKH_GRAPH_INIT_SIZE;
+		p->accesses = (vkh_graph_access_t*)realloc(p->accesses, p->accessReserved * sizeof(vkh_graph_access_t));
+	}
+	p->accesses[p->accessCount++] = (vkh_graph_access_t) {res, write, layout, stages, access};
+	g->compiled = false;
+}
+//declare a read of 'res' by 'pass' in 'layout' (ignored for buffers) from 'stages'.
+void vkh_render_graph_read (VkhRenderGraph g, uint32_t pass, uint32_t res, VkImageLayout layout,
+							VkPipelineStageFlags stages, VkAccessFlags access) {
+	_add_access (g, pass, res, false, layout, stages, access);
+}
+/**
+ * @brief declare a write of 'res' by 'pass'. Previous content is considered discarded unless the pass
+ * also reads the resource, passes producing it only for this one may then be culled.
+ */
+void vkh_render_graph_write (VkhRenderGraph g, uint32_t pass, uint32_t res, VkImageLayout layout,
+							 VkPipelineStageFlags stages, VkAccessFlags access) {
+	_add_access (g, pass, res, true, layout, stages, access);
+}
+bool vkh_render_graph_is_culled (VkhRenderGraph g, uint32_t pass) {
+	return g->passes[pass].culled;
+}
+
+static bool _reads (const vkh_graph_pass_t* p, uint32_t res) {
+	for (uint32_t i=0; i<p->accessCount; i++) {
+		if (p->accesses[i].resource == res && !p->accesses[i].write)
+			return true;
+	}
+	return false;
+}
+static bool _writes (const vkh_graph_pass_t* p, uint32_t res) {
+	for (uint32_t i=0; i<p->accessCount; i++) {
+		if (p->accesses[i].resource == res && p->accesses[i].write)
+			return true;
+	}
+	return false;
+}
+//walk passes backward from the outputs, passes writing nothing needed are culled.
+static void _cull (VkhRenderGraph g) {
+	bool anyOutput = false;
+	for (uint32_t i=0; i<g->resourceCount; i++) {
+		g->resources[i].needed = g->resources[i].output;
+		anyOutput |= g->resources[i].output;
+	}
+	for (uint32_t i=g->passCount; i-- > 0;) {
+		vkh_graph_pass_t* p = &g->passes[i];
+		bool writes = false, keep = !anyOutput;
+		for (uint32_t a=0; a<p->accessCount; a++) {
+			if (!p->accesses[a].write)
+				continue;
+			writes = true;
+			keep |= g->resources[p->accesses[a].resource].needed;
+		}
+		//passes without declared writes only have side effects
+		p->culled = writes && !keep;
+		if (p->culled)
+			continue;
+		for (uint32_t a=0; a<p->accessCount; a++) {
+			uint32_t res = p->accesses[a].resource;
+			if (p->accesses[a].write && !_reads (p, res))
+				g->resources[res].needed = false;
+		}
+		for (uint32_t a=0; a<p->accessCount; a++) {
+			if (!p->accesses[a].write)
+				g->resources[p->accesses[a].resource].needed = true;
+		}
+	}
+}
+/**
+ * @brief topological sort of the kept passes on their resource dependencies (read after write, write after
+ * read or write). Among ready passes, the ones on the queue of the previous pass are preferred to limit the
+ * number of batches, then declaration order.
+ */
+static void _sort (VkhRenderGraph g) {
+	uint32_t n = g->passCount;
+	bool* deps = (bool*)calloc((size_t)n * n + 1, sizeof(bool));//deps[a*n+b]: b depends on a
+	uint32_t* indegree = (uint32_t*)calloc(n + 1, sizeof(uint32_t));
+	bool* done = (bool*)calloc(n + 1, sizeof(bool));
+
+	for (uint32_t b=0; b<n; b++) {
+		vkh_graph_pass_t* pb = &g->passes[b];
+		if (pb->culled)
+			continue;
+		for (uint32_t i=0; i<pb->accessCount; i++) {
+			const vkh_graph_access_t* acc = &pb->accesses[i];
+			for (uint32_t a=b; a-- > 0;) {
+				vkh_graph_pass_t* pa = &g->passes[a];
+				if (pa->culled)
+					continue;
+				bool aWrites = _writes (pa, acc->resource);
+				if (aWrites || (acc->write && _reads (pa, acc->resource))) {
+					if (!deps[a*n+b]) {
+						deps[a*n+b] = true;
+						indegree[b]++;
+					}
+				}
+				if (aWrites)
+					break;//older accesses are ordered through this writer
+			}
+		}
+	}
+
+	g->order = (uint32_t*)realloc(g->order, (n + 1) * sizeof(uint32_t));
+	g->orderCount = 0;
+	uint32_t queue = VKH_GRAPH_QUEUE_GRAPHICS;
+	for (;;) {
+		uint32_t pick = VKH_GRAPH_NONE;
+		for (uint32_t i=0; i<n; i++) {
+			if (done[i] || g->passes[i].culled || indegree[i] > 0)
+				continue;
+			if (pick == VKH_GRAPH_NONE)
+				pick = i;
+			if (g->passes[i].queue == queue) {
+				pick = i;
+				break;
+			}
+		}
+		if (pick == VKH_GRAPH_NONE)
+			break;
+		done[pick] = true;
+		queue = g->passes[pick].queue;
+		g->order[g->orderCount++] = pick;
+		for (uint32_t b=0; b<n; b++) {
+			if (deps[pick*n+b])
+				indegree[b]--;
+		}
+	}
+	free (deps);
+	free (indegree);
+	free (done);
+}
+//alias pool lifetime of a transient resource for the current order, VKH_GRAPH_NONE if unused.
+static void _alias_lifetime (VkhRenderGraph g, const vkh_graph_resource_t* r, uint32_t* first, uint32_t* last) {
+	*first = *last = VKH_GRAPH_NONE;
+	if (r->firstPos == VKH_GRAPH_NONE)
+		return;
+	*first = r->asyncUsed ? 0 : r->firstPos;
+	*last = r->asyncUsed ? g->orderCount - 1 : r->lastPos;
+}
+//resources bound to the previous pool memory can not be bound again, they are replaced by unbound ones.
+static void _transient_recreate (VkhRenderGraph g, vkh_graph_resource_t* r) {
+	if (r->type == VK_OBJECT_TYPE_IMAGE) {
+		VkhImage old = (VkhImage)r->object;
+		r->object = vkh_image_create_unbound (g->dev, old->infos.format, old->infos.extent.width, old->infos.extent.height,
+											  old->infos.tiling, old->infos.usage);
+		vkh_image_destroy_force (old);
+	} else {
+		VkhBuffer old = (VkhBuffer)r->object;
+		r->object = vkh_buffer_create_unbound (g->dev, old->infos.usage, old->infos.size);
+		vkh_buffer_destroy_force (old);
+	}
+	r->aliasFirst = VKH_GRAPH_NONE;
+}
+/**
+ * @brief cull unused passes, compute the execution order and bind the transient resources to a single aliased
+ * allocation. Transient resources used by async compute passes are kept alive for the whole graph because their
+ * passes may overlap in time with any graphics pass. If the transient set or lifetimes changed since the memory
+ * was bound, in flight executions are waited and the transient resources are created and bound again.
+ */
+VkResult vkh_render_graph_compile (VkhRenderGraph g) {
+	_cull (g);
+	_sort (g);
+
+	for (uint32_t i=0; i<g->resourceCount; i++) {
+		g->resources[i].firstPos	= VKH_GRAPH_NONE;
+		g->resources[i].asyncUsed	= false;
+	}
+	for (uint32_t pos=0; pos<g->orderCount; pos++) {
+		vkh_graph_pass_t* p = &g->passes[g->order[pos]];
+		for (uint32_t a=0; a<p->accessCount; a++) {
+			vkh_graph_resource_t* r = &g->resources[p->accesses[a].resource];
+			if (r->firstPos == VKH_GRAPH_NONE)
+				r->firstPos = pos;
+			r->lastPos = pos;
+			r->asyncUsed |= p->queue == VKH_GRAPH_QUEUE_ASYNC_COMPUTE;
+		}
+	}
+	g->compiled = true;
+
+	bool changed = g->aliasPool == NULL;
+	for (uint32_t i=0; i<g->resourceCount && !changed; i++) {
+		vkh_graph_resource_t* r = &g->resources[i];
+		uint32_t first, last;
+		_alias_lifetime (g, r, &first, &last);
+		changed = r->transient && (first != r->aliasFirst || (first != VKH_GRAPH_NONE && last != r->aliasLast));
+	}
+	if (!changed)
+		return VK_SUCCESS;
+	if (g->aliasPool) {
+		for (uint32_t q=0; q<2; q++)
+			_wait_frames (g, q);
+		for (uint32_t i=0; i<g->resourceCount; i++) {
+			vkh_graph_resource_t* r = &g->resources[i];
+			if (r->transient && r->aliasFirst != VKH_GRAPH_NONE)
+				_transient_recreate (g, r);
+		}
+		vkh_alias_pool_destroy (g->aliasPool);
+	}
+	g->aliasPool = vkh_alias_pool_create (g->dev, VKH_MEMORY_USAGE_GPU_ONLY);
+	for (uint32_t i=0; i<g->resourceCount; i++) {
+		vkh_graph_resource_t* r = &g->resources[i];
+		uint32_t first, last;
+		_alias_lifetime (g, r, &first, &last);
+		if (!r->transient || first == VKH_GRAPH_NONE)
+			continue;
+		r->aliasFirst	= first;
+		r->aliasLast	= last;
+		if (r->type == VK_OBJECT_TYPE_IMAGE)
+			vkh_alias_pool_add_image (g->aliasPool, (VkhImage)r->object, first, last);
+		else
+			vkh_alias_pool_add_buffer (g->aliasPool, (VkhBuffer)r->object, first, last);
+	}
+	return vkh_alias_pool_bind (g->aliasPool);
+}
+
+static VkCommandBuffer _get_cmd (VkhRenderGraph g, vkh_graph_frame_t* fr, uint32_t q) {
+	if (fr->pools[q] == VK_NULL_HANDLE)
+		fr->pools[q] = vkh_cmd_pool_create (g->dev, g->families[q], VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+	if (fr->cmdUsed[q] == fr->cmdCount[q]) {
+		fr->cmds[q] = (VkCommandBuffer*)realloc(fr->cmds[q], (fr->cmdCount[q] + VKH_GRAPH_INIT_SIZE) * sizeof(VkCommandBuffer));
+		vkh_cmd_buffs_create (g->dev, fr->pools[q], VK_COMMAND_BUFFER_LEVEL_PRIMARY, VKH_GRAPH_INIT_SIZE, &fr->cmds[q][fr->cmdCount[q]]);
+		fr->cmdCount[q] += VKH_GRAPH_INIT_SIZE;
+	}
+	return fr->cmds[q][fr->cmdUsed[q]++];
+}
+static uint32_t _begin_batch (VkhRenderGraph g, vkh_graph_frame_t* fr, uint32_t q) {
+	if (g->batchCount == g->batchReserved) {
+		g->batchReserved = g->batchReserved ? g->batchReserved * 2 : VKH_GRAPH_INIT_SIZE;
+		g->batches = (vkh_graph_batch_t*)realloc(g->batches, g->batchReserved * sizeof(vkh_graph_batch_t));
+	}
+	vkh_graph_batch_t* b = &g->batches[g->batchCount];
+	memset (b, 0, sizeof(vkh_graph_batch_t));
+	b->queue		= q;
+	b->cmd			= _get_cmd (g, fr, q);
+	b->signalValue	= ++g->timelineValues[q];
+	vkh_cmd_begin (b->cmd, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	return g->batchCount++;
+}
+//wait for the previous execution in this frame slot and recycle its command buffers.
+static void _begin_frame (VkhRenderGraph g, vkh_graph_frame_t* fr, const uint32_t families[2]) {
+	for (uint32_t q=0; q<2; q++) {
+		if (families[q] != g->families[q]) {
+			_wait_frames (g, q);
+			_destroy_pools (g, q);
+			g->families[q] = families[q];
+			continue;
+		}
+		if (fr->values[q] > 0)
+			vkh_timeline_wait (g->dev, g->timelines[q], fr->values[q]);
+		if (fr->cmdUsed[q] > 0)
+			VK_CHECK_RESULT(vkResetCommandPool (g->dev->dev, fr->pools[q], 0));
+		fr->cmdUsed[q] = 0;
+	}
+}
+static void _grow_barriers (VkhRenderGraph g) {
+	if (g->imgBarrierCount < g->barrierReserved && g->buffBarrierCount < g->barrierReserved)
+		return;
+	g->barrierReserved = g->barrierReserved ? g->barrierReserved * 2 : VKH_GRAPH_INIT_SIZE;
+	g->imgBarriers = (VkImageMemoryBarrier*)realloc(g->imgBarriers, g->barrierReserved * sizeof(VkImageMemoryBarrier));
+	g->buffBarriers = (VkBufferMemoryBarrier*)realloc(g->buffBarriers, g->barrierReserved * sizeof(VkBufferMemoryBarrier));
+}
+static void _fill_barrier (vkh_graph_resource_t* r, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+						   uint32_t srcFamily, uint32_t dstFamily, VkImageMemoryBarrier* ib, VkBufferMemoryBarrier* bb) {
+	if (r->type == VK_OBJECT_TYPE_IMAGE) {
+		VkhImage img = (VkhImage)r->object;
+		*ib = (VkImageMemoryBarrier) { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+									   .srcAccessMask = srcAccess,
+									   .dstAccessMask = dstAccess,
+									   .oldLayout = r->layout,
+									   .newLayout = newLayout,
+									   .srcQueueFamilyIndex = srcFamily,
+									   .dstQueueFamilyIndex = dstFamily,
+									   .image = img->image,
+									   .subresourceRange = {r->aspect, 0, img->infos.mipLevels, 0, img->infos.arrayLayers}};
+	} else {
+		*bb = (VkBufferMemoryBarrier) { .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+										.srcAccessMask = srcAccess,
+										.dstAccessMask = dstAccess,
+										.srcQueueFamilyIndex = srcFamily,
+										.dstQueueFamilyIndex = dstFamily,
+										.buffer = ((VkhBuffer)r->object)->buffer,
+										.size = VK_WHOLE_SIZE };
+	}
+}
+//add a barrier to the batched ones of the pass being recorded.
+static void _push_barrier (VkhRenderGraph g, vkh_graph_resource_t* r, VkImageLayout newLayout, VkAccessFlags srcAccess,
+						   VkAccessFlags dstAccess, uint32_t srcFamily, uint32_t dstFamily) {
+	_grow_barriers (g);
+	if (r->type == VK_OBJECT_TYPE_IMAGE)
+		_fill_barrier (r, newLayout, srcAccess, dstAccess, srcFamily, dstFamily, &g->imgBarriers[g->imgBarrierCount++], NULL);
+	else
+		_fill_barrier (r, newLayout, srcAccess, dstAccess, srcFamily, dstFamily, NULL, &g->buffBarriers[g->buffBarrierCount++]);
+}
+//record a single barrier directly, used at the end of already recorded batches.
+static void _record_barrier (VkCommandBuffer cmd, vkh_graph_resource_t* r, VkImageLayout newLayout, VkPipelineStageFlags srcStages,
+							 VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess,
+							 uint32_t srcFamily, uint32_t dstFamily) {
+	VkImageMemoryBarrier ib;
+	VkBufferMemoryBarrier bb;
+	_fill_barrier (r, newLayout, srcAccess, dstAccess, srcFamily, dstFamily, &ib, &bb);
+	bool image = r->type == VK_OBJECT_TYPE_IMAGE;
+	vkCmdPipelineBarrier (cmd, srcStages ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0, 0, NULL,
+						  image ? 0 : 1, &bb, image ? 1 : 0, &ib);
+	VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
+}
+//resources state at the start of an execution: last used on the graphics queue in the first batch.
+static void _reset_states (VkhRenderGraph g) {
+	for (uint32_t i=0; i<g->resourceCount; i++) {
+		vkh_graph_resource_t* r = &g->resources[i];
+		bool image = r->type == VK_OBJECT_TYPE_IMAGE;
+		r->layout			= (image && !r->transient) ? ((VkhImage)r->object)->layout : VK_IMAGE_LAYOUT_UNDEFINED;
+		//previous frame or work outside the graph may still use it
+		r->writeStages		= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		r->writeAccess		= r->transient ? 0 : VK_ACCESS_MEMORY_WRITE_BIT;
+		r->readStages		= 0;
+		r->visibleStages	= 0;
+		r->visibleAccess	= 0;
+		r->lastQueue		= VKH_GRAPH_QUEUE_GRAPHICS;
+		r->lastBatch[0]		= 0;
+		r->lastBatch[1]		= VKH_GRAPH_NONE;
+		r->needed			= !r->transient;//content defined
+	}
+}
+/**
+ * @brief compute and record the batched barriers needed before the pass. Accesses from the other queue are
+ * synchronized with a timeline wait of the batch, and with a release/acquire pair if the queue families differ
+ * and the content has to be kept.
+ */
+static void _pass_barriers (VkhRenderGraph g, vkh_graph_pass_t* p, uint32_t batchIdx) {
+	vkh_graph_batch_t* b = &g->batches[batchIdx];
+	uint32_t q = b->queue;
+	VkPipelineStageFlags srcStages = 0, dstStages = 0;
+	g->imgBarrierCount = g->buffBarrierCount = 0;
+
+	for (uint32_t i=0; i<p->accessCount; i++) {
+		const vkh_graph_access_t* a = &p->accesses[i];
+		vkh_graph_resource_t* r = &g->resources[a->resource];
+		bool image = r->type == VK_OBJECT_TYPE_IMAGE;
+		VkImageLayout newLayout = image ? a->layout : VK_IMAGE_LAYOUT_UNDEFINED;
+		bool layoutChange = image && r->layout != newLayout;
+
+		if (r->lastQueue != q) {
+			uint32_t other = r->lastQueue;
+			vkh_graph_batch_t* ob = &g->batches[r->lastBatch[other]];
+			b->waitValue	= MAX(b->waitValue, ob->signalValue);
+			b->waitStages	|= a->stages;
+			if (g->families[other] != g->families[q] && r->needed) {
+				_record_barrier (ob->cmd, r, newLayout, r->writeStages | r->readStages, r->writeAccess,
+								 VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, g->families[other], g->families[q]);
+				_push_barrier (g, r, newLayout, 0, a->access, g->families[other], g->families[q]);
+				srcStages |= a->stages;
+				dstStages |= a->stages;
+			} else if (layoutChange) {
+				_push_barrier (g, r, newLayout, 0, a->access, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+				srcStages |= a->stages;
+				dstStages |= a->stages;
+			}
+			//semaphore wait made everything of the other queue available and visible
+			r->writeStages = r->readStages = 0;
+			r->writeAccess = 0;
+			r->visibleStages = a->stages;
+			r->visibleAccess = a->access;
+		} else {
+			VkPipelineStageFlags src = 0;
+			VkAccessFlags srcAccess = 0;
+			bool barrier = layoutChange;
+			if (a->write) {
+				src = r->writeStages | r->readStages;
+				srcAccess = r->writeAccess;
+				barrier |= src != 0;
+			} else if (r->writeStages && ((a->stages & ~r->visibleStages) || (a->access & ~r->visibleAccess))) {
+				src = r->writeStages;
+				srcAccess = r->writeAccess;
+				barrier = true;
+			} else if (layoutChange)
+				src = r->readStages;
+			if (barrier) {
+				_push_barrier (g, r, newLayout, srcAccess, a->access, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+				srcStages |= src ? src : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+				dstStages |= a->stages;
+				r->visibleStages |= a->stages;
+				r->visibleAccess |= a->access;
+			}
+		}
+
+		if (a->write) {
+			r->writeStages		= a->stages;
+			r->writeAccess		= a->access;
+			r->readStages		= 0;
+			r->visibleStages	= 0;
+			r->visibleAccess	= 0;
+			r->needed			= true;
+		} else
+			r->readStages |= a->stages;
+		r->layout		= newLayout;
+		r->lastQueue	= q;
+		r->lastBatch[q]	= batchIdx;
+	}
+	if (g->imgBarrierCount + g->buffBarrierCount > 0) {
+		vkCmdPipelineBarrier (b->cmd, srcStages, dstStages, 0, 0, NULL, g->buffBarrierCount, g->buffBarriers,
+							  g->imgBarrierCount, g->imgBarriers);
+		VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
+	}
+}
+/**
+ * @brief bring resources last used on the async compute family back to the graphics one and apply
+ * final layouts of the outputs. Returns the index of the last graphics batch.
+ */
+static uint32_t _end_execution (VkhRenderGraph g, vkh_graph_frame_t* fr, bool async) {
+	uint64_t lastCompute = 0, joined = 0;
+	uint32_t lastGraphics = 0;
+	for (uint32_t i=0; i<g->batchCount; i++) {
+		if (g->batches[i].queue == VKH_GRAPH_QUEUE_ASYNC_COMPUTE)
+			lastCompute = g->batches[i].signalValue;
+		else {
+			joined = MAX(joined, g->batches[i].waitValue);
+			lastGraphics = i;
+		}
+	}
+	bool transfers = false;
+	for (uint32_t i=0; i<g->resourceCount && async; i++) {
+		vkh_graph_resource_t* r = &g->resources[i];
+		transfers |= !r->transient && r->needed && r->lastQueue == VKH_GRAPH_QUEUE_ASYNC_COMPUTE &&
+				g->families[0] != g->families[1];
+	}
+	if (lastCompute > joined || transfers) {
+		lastGraphics = _begin_batch (g, fr, VKH_GRAPH_QUEUE_GRAPHICS);
+		g->batches[lastGraphics].waitValue	= lastCompute;
+		g->batches[lastGraphics].waitStages	= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	}
+	for (uint32_t i=0; i<g->resourceCount; i++) {
+		vkh_graph_resource_t* r = &g->resources[i];
+		if (r->firstPos == VKH_GRAPH_NONE)
+			continue;
+		bool image = r->type == VK_OBJECT_TYPE_IMAGE;
+		VkImageLayout newLayout = (image && r->output && r->finalLayout != VK_IMAGE_LAYOUT_UNDEFINED) ? r->finalLayout : r->layout;
+		if (transfers && !r->transient && r->needed && r->lastQueue == VKH_GRAPH_QUEUE_ASYNC_COMPUTE) {
+			_record_barrier (g->batches[r->lastBatch[1]].cmd, r, newLayout, r->writeStages | r->readStages, r->writeAccess,
+							 VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, g->families[1], g->families[0]);
+			_record_barrier (g->batches[lastGraphics].cmd, r, newLayout, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+							 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+							 g->families[1], g->families[0]);
+			r->lastQueue = VKH_GRAPH_QUEUE_GRAPHICS;
+		} else if (newLayout != r->layout) {
+			_record_barrier (g->batches[r->lastBatch[r->lastQueue]].cmd, r, newLayout, r->writeStages | r->readStages,
+							 r->writeAccess, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		}
+		r->layout = newLayout;
+		if (image)
+			((VkhImage)r->object)->layout = r->layout;
+		if (r->needed) {
+			if (image)
+				((VkhImage)r->object)->ownerFamily = g->families[r->lastQueue];
+			else
+				((VkhBuffer)r->object)->ownerFamily = g->families[r->lastQueue];
+		}
+	}
+	return lastGraphics;
+}
+/**
+ * @brief record and submit the kept passes. Consecutive passes of the same queue share a command buffer,
+ * queues are synchronized with one timeline semaphore each, waited at the first stages using the shared resources.
+ * @param computeQueue queue for VKH_GRAPH_QUEUE_ASYNC_COMPUTE passes, if NULL they run on graphicsQueue.
+ * @param waitSemaphore optional binary semaphore waited by the first graphics submission at 'waitStages'.
+ * @param signalSemaphore optional binary semaphore signaled with 'fence' once every pass has completed.
+ */
+VkResult vkh_render_graph_execute (VkhRenderGraph g, VkhQueue graphicsQueue, VkhQueue computeQueue,
+								   VkSemaphore waitSemaphore, VkPipelineStageFlags waitStages,
+								   VkSemaphore signalSemaphore, VkFence fence) {
+	if (!g->compiled) {
+		VkResult res = vkh_render_graph_compile (g);
+		if (res != VK_SUCCESS)
+			return res;
+	}
+	bool async = computeQueue != NULL && computeQueue != graphicsQueue;
+	VkhQueue queues[2] = { graphicsQueue, async ? computeQueue : graphicsQueue };
+	uint32_t families[2] = { graphicsQueue->familyIndex, queues[1]->familyIndex };
+	vkh_graph_frame_t* fr = &g->frames[g->frame];
+	_begin_frame (g, fr, families);
+	_reset_states (g);
+
+	g->batchCount = 0;
+	_begin_batch (g, fr, VKH_GRAPH_QUEUE_GRAPHICS);
+	for (uint32_t pos=0; pos<g->orderCount; pos++) {
+		vkh_graph_pass_t* p = &g->passes[g->order[pos]];
+		uint32_t q = (async && p->queue == VKH_GRAPH_QUEUE_ASYNC_COMPUTE) ? 1 : 0;
+		if (g->batches[g->batchCount - 1].queue != q)
+			_begin_batch (g, fr, q);
+		uint32_t batchIdx = g->batchCount - 1;
+		if (g->aliasPool)
+			vkh_alias_pool_cmd_barriers (g->aliasPool, g->batches[batchIdx].cmd, pos);
+		_pass_barriers (g, p, batchIdx);
+		if (p->func)
+			p->func (p->userData, g->batches[batchIdx].cmd);
+	}
+	uint32_t lastGraphics = _end_execution (g, fr, async);
+
+	VkResult result = VK_SUCCESS;
+	for (uint32_t i=0; i<g->batchCount && result == VK_SUCCESS; i++) {
+		vkh_graph_batch_t* b = &g->batches[i];
+		vkh_cmd_end (b->cmd);
+		vkh_submit_reset (g->submit);
+		vkh_submit_add_cmd (g->submit, b->cmd);
+		if (b->waitValue > 0)
+			vkh_submit_add_timeline_wait (g->submit, g->timelines[1 - b->queue], b->waitValue, b->waitStages);
+		if (i == 0 && waitSemaphore != VK_NULL_HANDLE)
+			vkh_submit_add_wait (g->submit, waitSemaphore, waitStages);
+		vkh_submit_add_timeline_signal (g->submit, g->timelines[b->queue], b->signalValue);
+		if (i == lastGraphics) {
+			if (signalSemaphore != VK_NULL_HANDLE)
+				vkh_submit_add_signal (g->submit, signalSemaphore);
+			vkh_submit_set_fence (g->submit, fence);
+		}
+		result = vkh_submit_commit (g->submit, queues[b->queue]);
+	}
+	fr->values[0] = g->timelineValues[0];
+	fr->values[1] = g->timelineValues[1];
+	g->frame = (g->frame + 1) % VKH_GRAPH_FRAMES;
+	return result;
+}
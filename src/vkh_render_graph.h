@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef VKH_RENDER_GRAPH_H
+#define VKH_RENDER_GRAPH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "vkh.h"
+
+#define VKH_GRAPH_FRAMES		2	//executions in flight before recording waits for the oldest one
+#define VKH_GRAPH_NAME_SIZE		32
+#define VKH_GRAPH_INIT_SIZE		8
+#define VKH_GRAPH_NONE			UINT32_MAX
+
+typedef struct {
+	uint32_t				resource;
+	bool					write;
+	VkImageLayout			layout;//images only
+	VkPipelineStageFlags	stages;
+	VkAccessFlags			access;
+}vkh_graph_access_t;
+
+typedef struct {
+	char					name[VKH_GRAPH_NAME_SIZE];
+	VkhGraphQueue			queue;
+	VkhPassFunc				func;
+	void*					userData;
+	vkh_graph_access_t*		accesses;
+	uint32_t				accessCount;
+	uint32_t				accessReserved;
+	bool					culled;
+}vkh_graph_pass_t;
+
+typedef struct {
+	VkObjectType			type;//VK_OBJECT_TYPE_IMAGE or VK_OBJECT_TYPE_BUFFER
+	void*					object;//VkhImage or VkhBuffer
+	VkImageAspectFlags		aspect;
+	bool					transient;//created and owned by the graph, memory aliased
+	bool					output;//kept alive by culling
+	VkImageLayout			finalLayout;
+	uint32_t				firstPos;//lifetime in execution order positions
+	uint32_t				lastPos;
+	bool					asyncUsed;//used by an async compute pass
+	uint32_t				aliasFirst;//lifetime registered in the alias pool, VKH_GRAPH_NONE if not bound
+	uint32_t				aliasLast;
+	//state while recording an execution
+	VkImageLayout			layout;
+	VkPipelineStageFlags	writeStages;
+	VkAccessFlags			writeAccess;
+	VkPipelineStageFlags	readStages;//reads since last write
+	VkPipelineStageFlags	visibleStages;//stages last write has been made visible to
+	VkAccessFlags			visibleAccess;
+	uint32_t				lastQueue;
+	uint32_t				lastBatch[2];//last batch using it on each queue
+	bool					needed;//needed by culling, content defined while recording
+}vkh_graph_resource_t;
+
+//consecutive passes of the execution order recorded in one command buffer and submitted on one queue.
+typedef struct {
+	uint32_t				queue;
+	VkCommandBuffer			cmd;
+	uint64_t				signalValue;
+	uint64_t				waitValue;//value of the other queue timeline to wait for, 0 if none
+	VkPipelineStageFlags	waitStages;
+}vkh_graph_batch_t;
+
+typedef struct {
+	VkCommandPool			pools[2];
+	VkCommandBuffer*		cmds[2];
+	uint32_t				cmdCount[2];
+	uint32_t				cmdUsed[2];
+	uint64_t				values[2];//timeline values signaled by the last execution in this slot
+}vkh_graph_frame_t;
+
+typedef struct _vkh_render_graph_t {
+	VkhDevice				dev;
+	vkh_graph_pass_t*		passes;
+	uint32_t				passCount;
+	uint32_t				passReserved;
+	vkh_graph_resource_t*	resources;
+	uint32_t				resourceCount;
+	uint32_t				resourceReserved;
+	uint32_t*				order;//kept passes in execution order
+	uint32_t				orderCount;
+	bool					compiled;
+	VkhAliasPool			aliasPool;
+	vkh_graph_batch_t*		batches;
+	uint32_t				batchCount;
+	uint32_t				batchReserved;
+	VkSemaphore				timelines[2];//one per queue, indexed by VkhGraphQueue
+	uint64_t				timelineValues[2];
+	uint32_t				families[2];//queue families pools have been created for
+	vkh_graph_frame_t		frames[VKH_GRAPH_FRAMES];
+	uint32_t				frame;
+	VkhSubmit				submit;
+	//barriers of the pass being recorded
+	VkImageMemoryBarrier*	imgBarriers;
+	VkBufferMemoryBarrier*	buffBarriers;
+	uint32_t				imgBarrierCount;
+	uint32_t				buffBarrierCount;
+	uint32_t				barrierReserved;
+}vkh_render_graph_t;
+
+#ifdef __cplusplus
+}
+#endif
+#endif
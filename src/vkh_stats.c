@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vkh_stats.h"
+#include "deps/tinycthread.h"
+#include "vkh_atomic.h"
+
+#ifdef VKH_ENABLE_STATS
+/**
+ * Each thread increments its own block without contention, blocks are summed on read.
+ * Blocks of exited threads are reused by new ones, keeping their values so that gauges
+ * incremented on one thread and decremented on another stay balanced.
+ */
+typedef struct _vkh_stats_block_t {
+	vkh_atomic_llong					values[VKH_STAT_COUNT];
+	vkh_atomic_bool						used;
+	struct _vkh_stats_block_t*			next;
+}vkh_stats_block_t;
+
+static vkh_atomic_ptr(vkh_stats_block_t*)	blocks;
+static _Thread_local vkh_stats_block_t*	threadBlock;
+static tss_t						threadKey;//release the block on thread exit
+static vkh_atomic_int				initState;//0 not initialized, 1 in progress, 2 done
+static mtx_t						resetMutex;
+static int64_t						base[VKH_STAT_COUNT];//counter values at last reset
+
+static void _release_block (void* block) {
+	vkh_atomic_store (&((vkh_stats_block_t*)block)->used, false);
+}
+static void _init () {
+	if (vkh_atomic_load (&initState) == 2)
+		return;
+	int expected = 0;
+	if (vkh_atomic_compare_exchange_strong (&initState, &expected, 1)) {
+		tss_create (&threadKey, _release_block);
+		mtx_init (&resetMutex, mtx_plain);
+		vkh_atomic_store (&initState, 2);
+	} else {
+		while (vkh_atomic_load (&initState) != 2)
+			thrd_yield ();
+	}
+}
+static vkh_stats_block_t* _get_block () {
+	_init ();
+	for (vkh_stats_block_t* b = vkh_atomic_ptr_load (&blocks); b; b = b->next) {
+		bool unused = false;
+		if (vkh_atomic_compare_exchange_strong (&b->used, &unused, true)) {
+			threadBlock = b;
+			tss_set (threadKey, b);
+			return b;
+		}
+	}
+	vkh_stats_block_t* b = (vkh_stats_block_t*)calloc(1, sizeof(vkh_stats_block_t));
+	vkh_atomic_init (&b->used, true);
+	b->next = vkh_atomic_ptr_load (&blocks);
+	while (!vkh_atomic_ptr_compare_exchange_weak (&blocks, &b->next, b));
+	threadBlock = b;
+	tss_set (threadKey, b);
+	return b;
+}
+void vkh_stats_add (vkh_stat_t stat, int64_t value) {
+	vkh_stats_block_t* b = threadBlock ? threadBlock : _get_block ();
+	vkh_atomic_fetch_add_explicit (&b->values[stat], value, vkh_memory_order_relaxed);
+}
+static void _sum (int64_t values[VKH_STAT_COUNT]) {
+	memset (values, 0, VKH_STAT_COUNT * sizeof(int64_t));
+	for (vkh_stats_block_t* b = vkh_atomic_ptr_load (&blocks); b; b = b->next) {
+		for (uint32_t i=0; i<VKH_STAT_COUNT; i++)
+			values[i] += vkh_atomic_load_explicit (&b->values[i], vkh_memory_order_relaxed);
+	}
+}
+#endif
+
+/**
+ * @brief process wide counters, summed over all threads and all devices. Counters are cleared by vkh_reset_stats,
+ * alive objects and memory are not. All zero if vkh is built without VKH_ENABLE_STATS.
+ */
+void vkh_get_stats (VkhStats* stats) {
+	memset (stats, 0, sizeof(VkhStats));
+#ifdef VKH_ENABLE_STATS
+	int64_t v[VKH_STAT_COUNT];
+	_init ();
+	_sum (v);
+	mtx_lock (&resetMutex);
+	for (uint32_t i=VKH_STAT_FIRST_COUNTER; i<VKH_STAT_COUNT; i++)
+		v[i] -= base[i];
+	mtx_unlock (&resetMutex);
+	stats->buffers			= v[VKH_STAT_BUFFERS];
+	stats->images			= v[VKH_STAT_IMAGES];
+	for (uint32_t i=0; i<VKH_STATS_MEMORY_USAGES; i++)
+		stats->memory[i]	= v[VKH_STAT_MEMORY + i];
+	stats->allocations		= (uint64_t)v[VKH_STAT_ALLOCATIONS];
+	stats->allocationTime	= (uint64_t)v[VKH_STAT_ALLOCATION_TIME];
+	stats->commandBuffers	= (uint64_t)v[VKH_STAT_COMMAND_BUFFERS];
+	stats->submits			= (uint64_t)v[VKH_STAT_SUBMITS];
+	stats->submitInfos		= (uint64_t)v[VKH_STAT_SUBMIT_INFOS];
+	stats->barriers			= (uint64_t)v[VKH_STAT_BARRIERS];
+	stats->fences			= (uint64_t)v[VKH_STAT_FENCES];
+	stats->semaphores		= (uint64_t)v[VKH_STAT_SEMAPHORES];
+	stats->presents			= (uint64_t)v[VKH_STAT_PRESENTS];
+#endif
+}
+//restart counters of all devices, for ex. once per frame.
+void vkh_reset_stats (void) {
+#ifdef VKH_ENABLE_STATS
+	int64_t v[VKH_STAT_COUNT];
+	_init ();
+	_sum (v);
+	mtx_lock (&resetMutex);
+	memcpy (base, v, sizeof(base));
+	mtx_unlock (&resetMutex);
+#endif
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef VKH_STATS_H
+#define VKH_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "vkh.h"
+
+typedef enum {
+	VKH_STAT_BUFFERS,
+	VKH_STAT_IMAGES,
+	VKH_STAT_MEMORY,//one slot per VkhMemoryUsage
+	VKH_STAT_ALLOCATIONS = VKH_STAT_MEMORY + VKH_STATS_MEMORY_USAGES,
+	VKH_STAT_ALLOCATION_TIME,
+	VKH_STAT_COMMAND_BUFFERS,
+	VKH_STAT_SUBMITS,
+	VKH_STAT_SUBMIT_INFOS,
+	VKH_STAT_BARRIERS,
+	VKH_STAT_FENCES,
+	VKH_STAT_SEMAPHORES,
+	VKH_STAT_PRESENTS,
+	VKH_STAT_COUNT
+}vkh_stat_t;
+
+//counters before VKH_STAT_ALLOCATIONS are gauges, not cleared by vkh_reset_stats.
+#define VKH_STAT_FIRST_COUNTER	VKH_STAT_ALLOCATIONS
+
+#ifdef VKH_ENABLE_STATS
+void vkh_stats_add (vkh_stat_t stat, int64_t value);
+# define VKH_STAT_ADD(stat, value)			vkh_stats_add (stat, (int64_t)(value))
+# define VKH_STAT_MEMORY_ADD(usage, bytes) do {				\
+	if ((uint32_t)(usage) < VKH_STATS_MEMORY_USAGES)			\
+		vkh_stats_add ((vkh_stat_t)(VKH_STAT_MEMORY + (usage)), (int64_t)(bytes));	\
+} while (0)
+//count an allocation and the time spent in 'call'.
+# define VKH_STAT_ALLOCATION(call) do {							\
+	uint64_t _t0 = vkh_host_time ();							\
+	call;														\
+	vkh_stats_add (VKH_STAT_ALLOCATION_TIME, (int64_t)(vkh_host_time () - _t0));	\
+	vkh_stats_add (VKH_STAT_ALLOCATIONS, 1);					\
+} while (0)
+#else
+# define VKH_STAT_ADD(stat, value)			do {} while (0)
+# define VKH_STAT_MEMORY_ADD(usage, bytes)	do {} while (0)
+# define VKH_STAT_ALLOCATION(call)			call
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif
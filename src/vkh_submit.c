@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vkh_submit.h"
+#include "vkh_queue.h"
+
+VkhSubmit vkh_submit_create () {
+	return (VkhSubmit)calloc(1, sizeof(vkh_submit_t));
+}
+void vkh_submit_destroy (VkhSubmit sub) {
+	if (sub == NULL)
+		return;
+	free (sub->cmds);
+	free (sub->waits);
+	free (sub->waitValues);
+	free (sub->waitStages);
+	free (sub->signals);
+	free (sub->signalValues);
+	free (sub);
+}
+//clear recorded command buffers, waits, signals and fence, keeping allocated arrays for reuse.
+void vkh_submit_reset (VkhSubmit sub) {
+	sub->cmdCount = sub->waitCount = sub->signalCount = 0;
+	sub->fence = VK_NULL_HANDLE;
+	sub->timelined = false;
+}
+static uint32_t _grow (uint32_t reserved) {
+	return reserved ? reserved * 2 : VKH_SUBMIT_INIT_SIZE;
+}
+void vkh_submit_add_cmd (VkhSubmit sub, VkCommandBuffer cmd) {
+	if (sub->cmdCount == sub->cmdReserved) {
+		sub->cmdReserved = _grow (sub->cmdReserved);
+		sub->cmds = (VkCommandBuffer*)realloc(sub->cmds, sub->cmdReserved * sizeof(VkCommandBuffer));
+	}
+	sub->cmds[sub->cmdCount++] = cmd;
+}
+static void _add_wait (VkhSubmit sub, VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stages) {
+	if (sub->waitCount == sub->waitReserved) {
+		sub->waitReserved = _grow (sub->waitReserved);
+		sub->waits		= (VkSemaphore*)realloc(sub->waits, sub->waitReserved * sizeof(VkSemaphore));
+		sub->waitValues	= (uint64_t*)realloc(sub->waitValues, sub->waitReserved * sizeof(uint64_t));
+		sub->waitStages	= (VkPipelineStageFlags*)realloc(sub->waitStages, sub->waitReserved * sizeof(VkPipelineStageFlags));
+	}
+	sub->waits[sub->waitCount]		= semaphore;
+	sub->waitValues[sub->waitCount]	= value;
+	sub->waitStages[sub->waitCount]	= stages;
+	sub->waitCount++;
+}
+static void _add_signal (VkhSubmit sub, VkSemaphore semaphore, uint64_t value) {
+	if (sub->signalCount == sub->signalReserved) {
+		sub->signalReserved = _grow (sub->signalReserved);
+		sub->signals		= (VkSemaphore*)realloc(sub->signals, sub->signalReserved * sizeof(VkSemaphore));
+		sub->signalValues	= (uint64_t*)realloc(sub->signalValues, sub->signalReserved * sizeof(uint64_t));
+	}
+	sub->signals[sub->signalCount]		= semaphore;
+	sub->signalValues[sub->signalCount]	= value;
+	sub->signalCount++;
+}
+//wait for the binary 'semaphore' before executing the 'stages' of the submitted commands.
+void vkh_submit_add_wait (VkhSubmit sub, VkSemaphore semaphore, VkPipelineStageFlags stages) {
+	_add_wait (sub, semaphore, 0, stages);
+}
+//wait for the timeline 'semaphore' to reach 'value' before executing the 'stages' of the submitted commands.
+void vkh_submit_add_timeline_wait (VkhSubmit sub, VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stages) {
+	_add_wait (sub, semaphore, value, stages);
+	sub->timelined = true;
+}
+//signal the binary 'semaphore' once the submitted commands have completed.
+void vkh_submit_add_signal (VkhSubmit sub, VkSemaphore semaphore) {
+	_add_signal (sub, semaphore, 0);
+}
+//set the timeline 'semaphore' to 'value' once the submitted commands have completed.
+void vkh_submit_add_timeline_signal (VkhSubmit sub, VkSemaphore semaphore, uint64_t value) {
+	_add_signal (sub, semaphore, value);
+	sub->timelined = true;
+}
+void vkh_submit_set_fence (VkhSubmit sub, VkFence fence) {
+	sub->fence = fence;
+}
+//timeline values are only chained if a timeline semaphore was added, so that binary only submits stay valid without timeline support.
+static void _fill_info (VkhSubmit sub, VkSubmitInfo* info, VkTimelineSemaphoreSubmitInfo* timelineInfo) {
+	*timelineInfo = (VkTimelineSemaphoreSubmitInfo) { .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+													  .waitSemaphoreValueCount = sub->waitCount,
+													  .pWaitSemaphoreValues = sub->waitValues,
+													  .signalSemaphoreValueCount = sub->signalCount,
+													  .pSignalSemaphoreValues = sub->signalValues };
+	*info = (VkSubmitInfo) { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+							 .pNext = sub->timelined ? timelineInfo : NULL,
+							 .waitSemaphoreCount = sub->waitCount,
+							 .pWaitSemaphores = sub->waits,
+							 .pWaitDstStageMask = sub->waitStages,
+							 .commandBufferCount = sub->cmdCount,
+							 .pCommandBuffers = sub->cmds,
+							 .signalSemaphoreCount = sub->signalCount,
+							 .pSignalSemaphores = sub->signals };
+}
+//submit now on 'queue', the builder may be reset and reused right after.
+VkResult vkh_submit_commit (VkhSubmit sub, VkhQueue queue) {
+	VkSubmitInfo info;
+	VkTimelineSemaphoreSubmitInfo timelineInfo;
+	_fill_info (sub, &info, &timelineInfo);
+	return vkh_queue_submit (queue, 1, &info, sub->fence);
+}
+//add to the queue pending submissions, see vkh_queue_enqueue.
+void vkh_submit_enqueue (VkhSubmit sub, VkhQueue queue) {
+	VkSubmitInfo info;
+	VkTimelineSemaphoreSubmitInfo timelineInfo;
+	_fill_info (sub, &info, &timelineInfo);
+	vkh_queue_enqueue (queue, 1, &info, sub->fence);
+}
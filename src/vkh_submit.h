@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef VKH_SUBMIT_H
+#define VKH_SUBMIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "vkh.h"
+
+#define VKH_SUBMIT_INIT_SIZE	4
+
+typedef struct _vkh_submit_t {
+	VkCommandBuffer*		cmds;
+	uint32_t				cmdCount;
+	uint32_t				cmdReserved;
+	VkSemaphore*			waits;
+	uint64_t*				waitValues;//0 for binary semaphores
+	VkPipelineStageFlags*	waitStages;
+	uint32_t				waitCount;
+	uint32_t				waitReserved;
+	VkSemaphore*			signals;
+	uint64_t*				signalValues;
+	uint32_t				signalCount;
+	uint32_t				signalReserved;
+	VkFence					fence;
+	bool					timelined;//a timeline semaphore was added, values are chained
+}vkh_submit_t;
+
+#ifdef __cplusplus
+}
+#endif
+#endif
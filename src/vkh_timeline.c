@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2018-2022 Jean-Philippe Bruyère <jp_bruyere@hotmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+ * Software, and to permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vkh_timeline.h"
+#include "vkh_device.h"
+
+static void _observe (VkhTimeline tl, uint64_t value) {
+	uint64_t cur = vkh_atomic_load_explicit (&tl->completed, vkh_memory_order_relaxed);
+	while (cur < value && !vkh_atomic_compare_exchange_weak_explicit (&tl->completed, &cur, value,
+																 vkh_memory_order_release, vkh_memory_order_relaxed));
+}
+//remaining nanoseconds until a vkh_host_time deadline, UINT64_MAX waits forever.
+static uint64_t _timeout (uint64_t deadline) {
+	if (deadline == UINT64_MAX)
+		return UINT64_MAX;
+	uint64_t now = vkh_host_time ();
+	return deadline > now ? deadline - now : 0;
+}
+
+VkhTimeline vkh_timeline_object_create (VkhDevice dev, uint64_t initialValue) {
+	VkhTimeline tl = (VkhTimeline)calloc(1, sizeof(vkh_timeline_t));
+	tl->dev = dev;
+	tl->semaphore = vkh_timeline_create (dev, initialValue);
+	vkh_atomic_init (&tl->reserved, initialValue);
+	vkh_atomic_init (&tl->completed, initialValue);
+	return tl;
+}
+void vkh_timeline_object_destroy (VkhTimeline tl) {
+	if (tl == NULL)
+		return;
+	vkDestroySemaphore (tl->dev->dev, tl->semaphore, NULL);
+	free (tl);
+}
+VkSemaphore vkh_timeline_get_semaphore (VkhTimeline tl) {
+	return tl->semaphore;
+}
+/**
+ * @brief atomically reserve 'count' consecutive values to signal, from any thread.
+ * @return the first reserved value.
+ */
+uint64_t vkh_timeline_reserve (VkhTimeline tl, uint32_t count) {
+	return vkh_atomic_fetch_add_explicit (&tl->reserved, count, vkh_memory_order_relaxed) + 1;
+}
+uint64_t vkh_timeline_get_reserved (VkhTimeline tl) {
+	return vkh_atomic_load_explicit (&tl->reserved, vkh_memory_order_relaxed);
+}
+//signal from the host, value must be greater than the current semaphore value.
+VkResult vkh_timeline_signal (VkhTimeline tl, uint64_t value) {
+	VkSemaphoreSignalInfo signalInfo = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+										 .semaphore = tl->semaphore,
+										 .value = value };
+	VkResult res = vkSignalSemaphore (tl->dev->dev, &signalInfo);
+	if (res == VK_SUCCESS)
+		_observe (tl, value);
+	return res;
+}
+//query the semaphore value and refresh the cached one.
+uint64_t vkh_timeline_get_completed (VkhTimeline tl) {
+	uint64_t value = 0;
+	if (vkGetSemaphoreCounterValue (tl->dev->dev, tl->semaphore, &value) != VK_SUCCESS)
+		return vkh_atomic_load_explicit (&tl->completed, vkh_memory_order_acquire);
+	_observe (tl, value);
+	return value;
+}
+//non blocking, the driver is only queried if the cached value is behind.
+bool vkh_timeline_is_done (VkhTimeline tl, uint64_t value) {
+	if (vkh_atomic_load_explicit (&tl->completed, vkh_memory_order_acquire) >= value)
+		return true;
+	return vkh_timeline_get_completed (tl) >= value;
+}
+static VkResult _wait (uint32_t count, const VkhTimeline* timelines, const uint64_t* values, bool waitAll,
+					   uint64_t deadline, uint32_t* pIndex, VkSemaphore* sems, uint64_t* vals, uint32_t* idx) {
+	uint32_t waitCount = 0;
+	for (uint32_t i=0; i<count; i++) {
+		if (vkh_atomic_load_explicit (&timelines[i]->completed, vkh_memory_order_acquire) >= values[i]) {
+			if (waitAll)
+				continue;
+			if (pIndex)
+				*pIndex = i;
+			return VK_SUCCESS;
+		}
+		sems[waitCount] = timelines[i]->semaphore;
+		vals[waitCount] = values[i];
+		idx[waitCount++] = i;
+	}
+	if (waitCount == 0)
+		return waitAll ? VK_SUCCESS : VK_TIMEOUT;
+	VkSemaphoreWaitInfo waitInfo = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+									 .flags = waitAll ? 0 : VK_SEMAPHORE_WAIT_ANY_BIT,
+									 .semaphoreCount = waitCount,
+									 .pSemaphores = sems,
+									 .pValues = vals };
+	//all timelines must belong to the same device
+	VkResult res = vkWaitSemaphores (timelines[idx[0]]->dev->dev, &waitInfo, _timeout (deadline));
+	if (res != VK_SUCCESS)
+		return res;
+	if (waitAll) {
+		for (uint32_t i=0; i<waitCount; i++)
+			_observe (timelines[idx[i]], vals[i]);
+		return res;
+	}
+	for (uint32_t i=0; i<waitCount; i++) {
+		if (vkh_timeline_get_completed (timelines[idx[i]]) >= vals[i]) {
+			if (pIndex)
+				*pIndex = idx[i];
+			break;
+		}
+	}
+	return res;
+}
+/**
+ * @brief wait for several timelines to reach their value, all of them or any of them.
+ * Timelines already known as reached skip the driver wait.
+ * @param deadline absolute vkh_host_time in nanoseconds, 0 to poll, UINT64_MAX to wait forever.
+ * @param pIndex if not NULL, receive the index of a reached timeline when waiting for any.
+ * @return VK_SUCCESS, VK_TIMEOUT or an error.
+ */
+VkResult vkh_timelines_wait (uint32_t count, const VkhTimeline* timelines, const uint64_t* values, bool waitAll,
+							 uint64_t deadline, uint32_t* pIndex) {
+	if (count <= VKH_TIMELINE_WAIT_STACK) {
+		VkSemaphore sems[VKH_TIMELINE_WAIT_STACK];
+		uint64_t vals[VKH_TIMELINE_WAIT_STACK];
+		uint32_t idx[VKH_TIMELINE_WAIT_STACK];
+		return _wait (count, timelines, values, waitAll, deadline, pIndex, sems, vals, idx);
+	}
+	VkSemaphore* sems	= (VkSemaphore*)malloc(count * sizeof(VkSemaphore));
+	uint64_t* vals		= (uint64_t*)malloc(count * sizeof(uint64_t));
+	uint32_t* idx		= (uint32_t*)malloc(count * sizeof(uint32_t));
+	VkResult res = _wait (count, timelines, values, waitAll, deadline, pIndex, sems, vals, idx);
+	free (sems);
+	free (vals);
+	free (idx);
+	return res;
+}
+/**
+ * @brief wait for 'tl' to reach 'value'.
+ * @param deadline absolute vkh_host_time in nanoseconds, 0 to poll, UINT64_MAX to wait forever.
+ * @return VK_SUCCESS, VK_TIMEOUT or an error.
+ */
+VkResult vkh_timeline_wait_until (VkhTimeline tl, uint64_t value, uint64_t deadline) {
+	VkSemaphore sem;
+	uint64_t val;
+	uint32_t idx;
+	return _wait (1, &tl, &value, true, deadline, NULL, &sem, &val, &idx);
+}
@@ -21,6 +21,7 @@
  */
 #include "vkh_queue.h"
 #include "vkh_device.h"
+#include "vkh_stats.h"
 
 #define CHECK_BIT(var,pos) (((var)>>(pos)) & 1)
 
@@ -30,6 +31,7 @@ VkFence vkh_fence_create (VkhDevice dev) {
 									.pNext = NULL,
 									.flags = 0 };
 	VK_CHECK_RESULT(vkCreateFence(dev->dev, &fenceInfo, NULL, &fence));
+	VKH_STAT_ADD(VKH_STAT_FENCES, 1);
 	return fence;
 }
 VkFence vkh_fence_create_signaled (VkhDevice dev) {
@@ -38,6 +40,7 @@ VkFence vkh_fence_create_signaled (VkhDevice dev) {
 									.pNext = NULL,
 									.flags = VK_FENCE_CREATE_SIGNALED_BIT };
 	VK_CHECK_RESULT(vkCreateFence(dev->dev, &fenceInfo, NULL, &fence));
+	VKH_STAT_ADD(VKH_STAT_FENCES, 1);
 	return fence;
 }
 VkSemaphore vkh_semaphore_create (VkhDevice dev) {
@@ -46,6 +49,7 @@ VkSemaphore vkh_semaphore_create (VkhDevice dev) {
 								   .pNext = NULL,
 								   .flags = 0};
 	VK_CHECK_RESULT(vkCreateSemaphore(dev->dev, &info, NULL, &semaphore));
+	VKH_STAT_ADD(VKH_STAT_SEMAPHORES, 1);
 	return semaphore;
 }
 VkSemaphore vkh_timeline_create (VkhDevice dev, uint64_t initialValue) {
@@ -58,6 +62,7 @@ VkSemaphore vkh_timeline_create (VkhDevice dev, uint64_t initialValue) {
 								   .pNext = &timelineInfo,
 								   .flags = 0};
 	VK_CHECK_RESULT(vkCreateSemaphore(dev->dev, &info, NULL, &semaphore));
+	VKH_STAT_ADD(VKH_STAT_SEMAPHORES, 1);
 	return semaphore;
 }
 
@@ -93,7 +98,7 @@ void vkh_cmd_submit_timelined (VkhQueue queue, VkCommandBuffer *pCmdBuff, VkSema
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = pCmdBuff;
 
-	VK_CHECK_RESULT(vkQueueSubmit(queue->queue, 1, &submitInfo, VK_NULL_HANDLE));
+	VK_CHECK_RESULT(vkh_queue_submit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 }
 void vkh_cmd_submit_timelined2 (VkhQueue queue, VkCommandBuffer *pCmdBuff, VkSemaphore timelines[2], const uint64_t waits[2], const uint64_t signals[2]) {
 	static VkPipelineStageFlags stageFlags[2] = { VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
@@ -116,7 +121,7 @@ void vkh_cmd_submit_timelined2 (VkhQueue queue, VkCommandBuffer *pCmdBuff, VkSem
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = pCmdBuff;
 
-	VK_CHECK_RESULT(vkQueueSubmit(queue->queue, 1, &submitInfo, VK_NULL_HANDLE));
+	VK_CHECK_RESULT(vkh_queue_submit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 }
 VkEvent vkh_event_create (VkhDevice dev) {
 	VkEvent evt;
@@ -124,6 +129,65 @@ VkEvent vkh_event_create (VkhDevice dev) {
 	VK_CHECK_RESULT(vkCreateEvent (dev->dev, &evtInfo, NULL, &evt));
 	return evt;
 }
+/**
+ * @brief record the signal half (wait false) or the wait half of a split barrier, both halves are given the same
+ * barrier. The event is reset after the wait so that it can be reused by the next split barrier.
+ */
+void vkh_cmd_split_barrier (VkhDevice dev, VkCommandBuffer cmd, VkEvent evt, bool wait,
+							VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages,
+							const VkBufferMemoryBarrier* buffBarrier, const VkImageMemoryBarrier* imgBarrier) {
+#ifdef VK_VERSION_1_3
+	if (dev->CmdSetEvent2) {
+		//synchronization2 needs the whole dependency on signal, vkCmdWaitEvents2 must repeat it
+		VkBufferMemoryBarrier2 buffBarrier2;
+		VkImageMemoryBarrier2 imgBarrier2;
+		VkDependencyInfo dep = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+		if (buffBarrier) {
+			buffBarrier2 = (VkBufferMemoryBarrier2) { .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+													  .srcStageMask = srcStages,
+													  .srcAccessMask = buffBarrier->srcAccessMask,
+													  .dstStageMask = dstStages,
+													  .dstAccessMask = buffBarrier->dstAccessMask,
+													  .srcQueueFamilyIndex = buffBarrier->srcQueueFamilyIndex,
+													  .dstQueueFamilyIndex = buffBarrier->dstQueueFamilyIndex,
+													  .buffer = buffBarrier->buffer,
+													  .offset = buffBarrier->offset,
+													  .size = buffBarrier->size };
+			dep.bufferMemoryBarrierCount = 1;
+			dep.pBufferMemoryBarriers = &buffBarrier2;
+		}
+		if (imgBarrier) {
+			imgBarrier2 = (VkImageMemoryBarrier2) { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+													.srcStageMask = srcStages,
+													.srcAccessMask = imgBarrier->srcAccessMask,
+													.dstStageMask = dstStages,
+													.dstAccessMask = imgBarrier->dstAccessMask,
+													.oldLayout = imgBarrier->oldLayout,
+													.newLayout = imgBarrier->newLayout,
+													.srcQueueFamilyIndex = imgBarrier->srcQueueFamilyIndex,
+													.dstQueueFamilyIndex = imgBarrier->dstQueueFamilyIndex,
+													.image = imgBarrier->image,
+													.subresourceRange = imgBarrier->subresourceRange };
+			dep.imageMemoryBarrierCount = 1;
+			dep.pImageMemoryBarriers = &imgBarrier2;
+		}
+		if (wait) {
+			dev->CmdWaitEvents2 (cmd, 1, &evt, &dep);
+			dev->CmdResetEvent2 (cmd, evt, dstStages);
+			VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
+		} else
+			dev->CmdSetEvent2 (cmd, evt, &dep);
+		return;
+	}
+#endif
+	if (wait) {
+		vkCmdWaitEvents (cmd, 1, &evt, srcStages, dstStages, 0, NULL,
+						 buffBarrier ? 1 : 0, buffBarrier, imgBarrier ? 1 : 0, imgBarrier);
+		vkCmdResetEvent (cmd, evt, dstStages);
+		VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
+	} else
+		vkCmdSetEvent (cmd, evt, srcStages);
+}
 VkCommandPool vkh_cmd_pool_create (VkhDevice dev, uint32_t qFamIndex, VkCommandPoolCreateFlags flags){
 	VkCommandPool cmdPool;
 	VkCommandPoolCreateInfo cmd_pool_info = { .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
@@ -141,6 +205,7 @@ VkCommandBuffer vkh_cmd_buff_create (VkhDevice dev, VkCommandPool cmdPool, VkCom
 										.level = level,
 										.commandBufferCount = 1 };
 	VK_CHECK_RESULT (vkAllocateCommandBuffers (dev->dev, &cmd, &cmdBuff));
+	VKH_STAT_ADD(VKH_STAT_COMMAND_BUFFERS, 1);
 	return cmdBuff;
 }
 void vkh_cmd_buffs_create (VkhDevice dev, VkCommandPool cmdPool, VkCommandBufferLevel level, uint32_t count, VkCommandBuffer* cmdBuffs){
@@ -150,6 +215,7 @@ void vkh_cmd_buffs_create (VkhDevice dev, VkCommandPool cmdPool, VkCommandBuffer
 										.level = level,
 										.commandBufferCount = count };
 	VK_CHECK_RESULT (vkAllocateCommandBuffers (dev->dev, &cmd, cmdBuffs));
+	VKH_STAT_ADD(VKH_STAT_COMMAND_BUFFERS, count);
 }
 void vkh_cmd_begin(VkCommandBuffer cmdBuff, VkCommandBufferUsageFlags flags) {
 	VkCommandBufferBeginInfo cmd_buf_info = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -168,7 +234,7 @@ void vkh_cmd_submit(VkhQueue queue, VkCommandBuffer *pCmdBuff, VkFence fence){
 								 .pWaitDstStageMask = &stageFlags,
 								 .commandBufferCount = 1,
 								 .pCommandBuffers = pCmdBuff};
-	VK_CHECK_RESULT(vkQueueSubmit(queue->queue, 1, &submit_info, fence));
+	VK_CHECK_RESULT(vkh_queue_submit(queue, 1, &submit_info, fence));
 }
 void vkh_cmd_submit_with_semaphores(VkhQueue queue, VkCommandBuffer *pCmdBuff, VkSemaphore waitSemaphore,
 									VkSemaphore signalSemaphore, VkFence fence){
@@ -188,9 +254,30 @@ void vkh_cmd_submit_with_semaphores(VkhQueue queue, VkCommandBuffer *pCmdBuff, V
 		submit_info.pSignalSemaphores= &signalSemaphore;
 	}
 
-	VK_CHECK_RESULT(vkQueueSubmit(queue->queue, 1, &submit_info, fence));
+	VK_CHECK_RESULT(vkh_queue_submit(queue, 1, &submit_info, fence));
 }
 
+/**
+ * @brief submit the release half of queue family ownership transfers on 'srcQueue' signaling the binary
+ * semaphore 'link', then the acquire half on 'dstQueue' waiting for it before 'dstStages'.
+ * @param fence optional, signaled with the acquire submission.
+ */
+void vkh_cmd_submit_ownership_transfer (VkhQueue srcQueue, VkCommandBuffer *pReleaseCmd, VkhQueue dstQueue,
+										VkCommandBuffer *pAcquireCmd, VkSemaphore link, VkPipelineStageFlags dstStages, VkFence fence) {
+	VkSubmitInfo release = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+							 .commandBufferCount = 1,
+							 .pCommandBuffers = pReleaseCmd,
+							 .signalSemaphoreCount = 1,
+							 .pSignalSemaphores = &link};
+	VkSubmitInfo acquire = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+							 .waitSemaphoreCount = 1,
+							 .pWaitSemaphores = &link,
+							 .pWaitDstStageMask = &dstStages,
+							 .commandBufferCount = 1,
+							 .pCommandBuffers = pAcquireCmd};
+	VK_CHECK_RESULT(vkh_queue_submit(srcQueue, 1, &release, VK_NULL_HANDLE));
+	VK_CHECK_RESULT(vkh_queue_submit(dstQueue, 1, &acquire, fence));
+}
 
 void set_image_layout(VkCommandBuffer cmdBuff, VkImage image, VkImageAspectFlags aspectMask, VkImageLayout old_image_layout,
 					  VkImageLayout new_image_layout, VkPipelineStageFlags src_stages, VkPipelineStageFlags dest_stages) {
@@ -252,6 +339,7 @@ void set_image_layout_subres(VkCommandBuffer cmdBuff, VkImage image, VkImageSubr
 	}
 
 	vkCmdPipelineBarrier(cmdBuff, src_stages, dest_stages, 0, 0, NULL, 0, NULL, 1, &image_memory_barrier);
+	VKH_STAT_ADD(VKH_STAT_BARRIERS, 1);
 }
 
 bool vkh_memory_type_from_properties(VkPhysicalDeviceMemoryProperties* memory_properties, uint32_t typeBits, VkhMemoryUsage memUsage, uint32_t *typeIndex) {